@@ -6,23 +6,23 @@ target triple = "x86_64-pc-linux-gnu"
 ; Function Attrs: noinline nounwind uwtable
 define dso_local i32 @bar(i32 noundef %a, i32 noundef %b) #0 {
 entry:
-  %lcm.tmp = add i32 %a, %b
-  %cmp = icmp sgt i32 %a, 10
-  br i1 %cmp, label %if.then, label %if.else
+  %lcm.tmp = add nsw i32 %a, %b
+  %lcm.tmp1 = icmp sgt i32 %a, 10
+  br i1 %lcm.tmp1, label %if.then, label %if.else
 
 if.then:                                          ; preds = %entry
-  %lcm.tmp1 = sub i32 %a, %b
+  %lcm.tmp2 = sub nsw i32 %a, %b
   br label %if.end
 
 if.else:                                          ; preds = %entry
-  %lcm.tmp2 = mul i32 %a, %b
+  %lcm.tmp3 = mul nsw i32 %a, %b
   br label %if.end
 
 if.end:                                           ; preds = %if.else, %if.then
-  %x.0 = phi i32 [ %lcm.tmp1, %if.then ], [ %lcm.tmp, %if.else ]
-  %y.0 = phi i32 [ %lcm.tmp, %if.then ], [ %lcm.tmp2, %if.else ]
-  %lcm.tmp3 = mul i32 %x.0, %y.0
-  ret i32 %lcm.tmp3
+  %x.0 = phi i32 [ %lcm.tmp2, %if.then ], [ %lcm.tmp, %if.else ]
+  %y.0 = phi i32 [ %lcm.tmp, %if.then ], [ %lcm.tmp3, %if.else ]
+  %mul3 = mul nsw i32 %x.0, %y.0
+  ret i32 %mul3
 }
 
 attributes #0 = { noinline nounwind uwtable "frame-pointer"="all" "min-legal-vector-width"="0" "no-trapping-math"="true" "stack-protector-buffer-size"="8" "target-cpu"="x86-64" "target-features"="+cmov,+cx8,+fxsr,+mmx,+sse,+sse2,+x87" "tune-cpu"="generic" }
@@ -6,26 +6,24 @@ target triple = "x86_64-pc-linux-gnu"
 ; Function Attrs: noinline nounwind uwtable
 define dso_local i32 @foo(i32 noundef %a, i32 noundef %b, i32 noundef %c) #0 {
 entry:
-  %lcm.tmp = add i32 %a, %b
-  %lcm.tmp1 = mul i32 %a, %b
-  %cmp = icmp sgt i32 %c, 0
-  br i1 %cmp, label %if.then, label %if.else
+  %lcm.tmp = add nsw i32 %a, %b
+  %lcm.tmp1 = icmp sgt i32 %c, 0
+  %lcm.tmp2 = mul nsw i32 %a, %b
+  br i1 %lcm.tmp1, label %if.then, label %if.else
 
 if.then:                                          ; preds = %entry
-  %lcm.tmp2 = mul i32 %a, %b
-  %lcm.tmp3 = add i32 %lcm.tmp, 1
+  %lcm.tmp3 = add nsw i32 %lcm.tmp, 1
   br label %if.end
 
 if.else:                                          ; preds = %entry
-  %lcm.tmp4 = mul i32 %a, %b
-  %lcm.tmp5 = sub i32 %lcm.tmp, 1
+  %lcm.tmp4 = sub nsw i32 %lcm.tmp, 1
   br label %if.end
 
 if.end:                                           ; preds = %if.else, %if.then
-  %y.0 = phi i32 [ %lcm.tmp1, %if.then ], [ %lcm.tmp1, %if.else ]
-  %z.0 = phi i32 [ %lcm.tmp3, %if.then ], [ %lcm.tmp5, %if.else ]
-  %lcm.tmp6 = add i32 %y.0, %z.0
-  ret i32 %lcm.tmp6
+  %y.0 = phi i32 [ %lcm.tmp2, %if.then ], [ %lcm.tmp2, %if.else ]
+  %z.0 = phi i32 [ %lcm.tmp3, %if.then ], [ %lcm.tmp4, %if.else ]
+  %add3 = add nsw i32 %y.0, %z.0
+  ret i32 %add3
 }
 
 attributes #0 = { noinline nounwind uwtable "frame-pointer"="all" "min-legal-vector-width"="0" "no-trapping-math"="true" "stack-protector-buffer-size"="8" "target-cpu"="x86-64" "target-features"="+cmov,+cx8,+fxsr,+mmx,+sse,+sse2,+x87" "tune-cpu"="generic" }
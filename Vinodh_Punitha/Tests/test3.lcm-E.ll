@@ -6,30 +6,26 @@ target triple = "x86_64-pc-linux-gnu"
 ; Function Attrs: noinline nounwind uwtable
 define dso_local i32 @loop_test(i32 noundef %a, i32 noundef %b, i32 noundef %n) #0 {
 entry:
-  %lcm.tmp = add i32 %a, %b
+  %lcm.tmp = add nsw i32 %a, %b
   br label %for.cond
 
 for.cond:                                         ; preds = %for.inc, %entry
   %y.0 = phi i32 [ 0, %entry ], [ %add2, %for.inc ]
-  %i.0 = phi i32 [ 0, %entry ], [ %lcm.tmp2, %for.inc ]
-  %lcm.tmp1 = add i32 %y.0, %lcm.tmp
+  %i.0 = phi i32 [ 0, %entry ], [ %lcm.tmp1, %for.inc ]
   %cmp = icmp slt i32 %i.0, %n
   br i1 %cmp, label %for.body, label %for.end
 
 for.body:                                         ; preds = %for.cond
-  %lcm.tmp2 = add i32 %i.0, 1
-  %lcm.tmp3 = add i32 %y.0, %lcm.tmp
+  %lcm.tmp1 = add nsw i32 %i.0, 1
   %add2 = add nsw i32 %y.0, %lcm.tmp
   br label %for.inc
 
 for.inc:                                          ; preds = %for.body
-  %lcm.tmp4 = add i32 %i.0, 1
-  %lcm.tmp5 = add i32 %y.0, %lcm.tmp
   br label %for.cond, !llvm.loop !6
 
 for.end:                                          ; preds = %for.cond
-  %lcm.tmp6 = add i32 %y.0, %lcm.tmp
-  ret i32 %lcm.tmp1
+  %lcm.tmp2 = add nsw i32 %y.0, %lcm.tmp
+  ret i32 %lcm.tmp2
 }
 
 attributes #0 = { noinline nounwind uwtable "frame-pointer"="all" "min-legal-vector-width"="0" "no-trapping-math"="true" "stack-protector-buffer-size"="8" "target-cpu"="x86-64" "target-features"="+cmov,+cx8,+fxsr,+mmx,+sse,+sse2,+x87" "tune-cpu"="generic" }
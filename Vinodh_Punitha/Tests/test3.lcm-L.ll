@@ -6,26 +6,25 @@ target triple = "x86_64-pc-linux-gnu"
 ; Function Attrs: noinline nounwind uwtable
 define dso_local i32 @loop_test(i32 noundef %a, i32 noundef %b, i32 noundef %n) #0 {
 entry:
-  %lcm.tmp = add i32 %a, %b
+  %add = add nsw i32 %a, %b
   br label %for.cond
 
 for.cond:                                         ; preds = %for.inc, %entry
   %y.0 = phi i32 [ 0, %entry ], [ %add2, %for.inc ]
-  %i.0 = phi i32 [ 0, %entry ], [ %lcm.tmp1, %for.inc ]
+  %i.0 = phi i32 [ 0, %entry ], [ %inc, %for.inc ]
   %cmp = icmp slt i32 %i.0, %n
   br i1 %cmp, label %for.body, label %for.end
 
 for.body:                                         ; preds = %for.cond
-  %lcm.tmp1 = add i32 %i.0, 1
-  %add2 = add nsw i32 %y.0, %lcm.tmp
+  %add2 = add nsw i32 %y.0, %add
   br label %for.inc
 
 for.inc:                                          ; preds = %for.body
-  %lcm.tmp2 = add i32 %i.0, 1
+  %inc = add nsw i32 %i.0, 1
   br label %for.cond, !llvm.loop !6
 
 for.end:                                          ; preds = %for.cond
-  %add3 = add nsw i32 %y.0, %lcm.tmp
+  %add3 = add nsw i32 %y.0, %add
   ret i32 %add3
 }
 
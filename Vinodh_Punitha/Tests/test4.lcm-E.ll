@@ -6,39 +6,34 @@ target triple = "x86_64-pc-linux-gnu"
 ; Function Attrs: noinline nounwind uwtable
 define dso_local i32 @nested_if_test(i32 noundef %a, i32 noundef %b, i32 noundef %c, i32 noundef %d) #0 {
 entry:
-  %lcm.tmp = mul i32 %c, %d
-  %cmp = icmp sgt i32 %a, 0
-  br i1 %cmp, label %if.then, label %if.else4
+  %lcm.tmp = icmp sgt i32 %a, 0
+  %lcm.tmp1 = mul nsw i32 %c, %d
+  br i1 %lcm.tmp, label %if.then, label %if.else4
 
 if.then:                                          ; preds = %entry
-  %lcm.tmp1 = mul i32 %c, %d
-  %cmp1 = icmp sgt i32 %b, 0
-  br i1 %cmp1, label %if.then2, label %if.else
+  %lcm.tmp2 = icmp sgt i32 %b, 0
+  br i1 %lcm.tmp2, label %if.then2, label %if.else
 
 if.then2:                                         ; preds = %if.then
-  %lcm.tmp2 = mul i32 %c, %d
   br label %if.end
 
 if.else:                                          ; preds = %if.then
-  %lcm.tmp3 = mul i32 %c, %d
-  %lcm.tmp4 = add i32 %c, %d
+  %lcm.tmp3 = add nsw i32 %c, %d
   br label %if.end
 
 if.end:                                           ; preds = %if.else, %if.then2
-  %x.0 = phi i32 [ %lcm.tmp, %if.then2 ], [ %lcm.tmp4, %if.else ]
-  %lcm.tmp5 = mul i32 %c, %d
+  %x.0 = phi i32 [ %lcm.tmp1, %if.then2 ], [ %lcm.tmp3, %if.else ]
   br label %if.end6
 
 if.else4:                                         ; preds = %entry
-  %lcm.tmp6 = mul i32 %c, %d
-  %lcm.tmp7 = sub i32 %c, %d
+  %lcm.tmp4 = sub nsw i32 %c, %d
   br label %if.end6
 
 if.end6:                                          ; preds = %if.else4, %if.end
-  %x.1 = phi i32 [ %x.0, %if.end ], [ %lcm.tmp7, %if.else4 ]
-  %y.0 = phi i32 [ %lcm.tmp, %if.end ], [ %lcm.tmp, %if.else4 ]
-  %lcm.tmp8 = add i32 %x.1, %y.0
-  ret i32 %lcm.tmp8
+  %x.1 = phi i32 [ %x.0, %if.end ], [ %lcm.tmp4, %if.else4 ]
+  %y.0 = phi i32 [ %lcm.tmp1, %if.end ], [ %lcm.tmp1, %if.else4 ]
+  %add7 = add nsw i32 %x.1, %y.0
+  ret i32 %add7
 }
 
 attributes #0 = { noinline nounwind uwtable "frame-pointer"="all" "min-legal-vector-width"="0" "no-trapping-math"="true" "stack-protector-buffer-size"="8" "target-cpu"="x86-64" "target-features"="+cmov,+cx8,+fxsr,+mmx,+sse,+sse2,+x87" "tune-cpu"="generic" }
@@ -6,41 +6,37 @@ target triple = "x86_64-pc-linux-gnu"
 ; Function Attrs: noinline nounwind uwtable
 define dso_local i32 @nested_if_test(i32 noundef %a, i32 noundef %b, i32 noundef %c, i32 noundef %d) #0 {
 entry:
-  %lcm.tmp = mul i32 %c, %d
-  %lcm.tmp1 = add i32 %c, %d
-  %lcm.tmp2 = sub i32 %c, %d
   %cmp = icmp sgt i32 %a, 0
   br i1 %cmp, label %if.then, label %if.else4
 
 if.then:                                          ; preds = %entry
-  %lcm.tmp3 = mul i32 %c, %d
   %cmp1 = icmp sgt i32 %b, 0
   br i1 %cmp1, label %if.then2, label %if.else
 
 if.then2:                                         ; preds = %if.then
-  %lcm.tmp4 = mul i32 %c, %d
+  %mul = mul nsw i32 %c, %d
   br label %if.end
 
 if.else:                                          ; preds = %if.then
-  %lcm.tmp5 = mul i32 %c, %d
-  %lcm.tmp6 = add i32 %c, %d
+  %add = add nsw i32 %c, %d
+  %lcm.tmp = mul nsw i32 %c, %d
   br label %if.end
 
 if.end:                                           ; preds = %if.else, %if.then2
-  %x.0 = phi i32 [ %lcm.tmp, %if.then2 ], [ %lcm.tmp1, %if.else ]
-  %lcm.tmp7 = mul i32 %c, %d
+  %lcm.phi = phi i32 [ %lcm.tmp, %if.else ], [ %mul, %if.then2 ]
+  %x.0 = phi i32 [ %mul, %if.then2 ], [ %add, %if.else ]
   br label %if.end6
 
 if.else4:                                         ; preds = %entry
-  %lcm.tmp8 = mul i32 %c, %d
-  %lcm.tmp9 = sub i32 %c, %d
+  %mul5 = mul nsw i32 %c, %d
+  %sub = sub nsw i32 %c, %d
   br label %if.end6
 
 if.end6:                                          ; preds = %if.else4, %if.end
-  %x.1 = phi i32 [ %x.0, %if.end ], [ %lcm.tmp2, %if.else4 ]
-  %y.0 = phi i32 [ %lcm.tmp, %if.end ], [ %lcm.tmp, %if.else4 ]
-  %lcm.tmp10 = add i32 %x.1, %y.0
-  ret i32 %lcm.tmp10
+  %x.1 = phi i32 [ %x.0, %if.end ], [ %sub, %if.else4 ]
+  %y.0 = phi i32 [ %lcm.phi, %if.end ], [ %mul5, %if.else4 ]
+  %add7 = add nsw i32 %x.1, %y.0
+  ret i32 %add7
 }
 
 attributes #0 = { noinline nounwind uwtable "frame-pointer"="all" "min-legal-vector-width"="0" "no-trapping-math"="true" "stack-protector-buffer-size"="8" "target-cpu"="x86-64" "target-features"="+cmov,+cx8,+fxsr,+mmx,+sse,+sse2,+x87" "tune-cpu"="generic" }
@@ -6,43 +6,37 @@ target triple = "x86_64-pc-linux-gnu"
 ; Function Attrs: noinline nounwind uwtable
 define dso_local i32 @complex_cfg(i32 noundef %a, i32 noundef %b, i32 noundef %c) #0 {
 entry:
-  %lcm.tmp = add i32 %b, %c
-  %cmp = icmp sgt i32 %a, 0
-  br i1 %cmp, label %if.then, label %if.else
+  %lcm.tmp = icmp sgt i32 %a, 0
+  %lcm.tmp1 = add nsw i32 %b, %c
+  br i1 %lcm.tmp, label %if.then, label %if.else
 
 if.then:                                          ; preds = %entry
-  %lcm.tmp1 = add i32 %b, %c
-  %lcm.tmp2 = mul i32 %a, 2
+  %lcm.tmp2 = mul nsw i32 %a, 2
   br label %if.end7
 
 if.else:                                          ; preds = %entry
-  %lcm.tmp3 = add i32 %b, %c
-  %cmp1 = icmp sgt i32 %b, 0
-  br i1 %cmp1, label %if.then2, label %if.else5
+  %lcm.tmp3 = icmp sgt i32 %b, 0
+  br i1 %lcm.tmp3, label %if.then2, label %if.else5
 
 if.then2:                                         ; preds = %if.else
-  %lcm.tmp4 = add i32 %b, %c
-  %lcm.tmp5 = mul i32 %a, 3
+  %lcm.tmp4 = mul nsw i32 %a, 3
   br label %if.end
 
 if.else5:                                         ; preds = %if.else
-  %lcm.tmp6 = add i32 %b, %c
-  %lcm.tmp7 = sub i32 %b, %c
-  %lcm.tmp8 = mul i32 %a, 4
+  %lcm.tmp5 = sub nsw i32 %b, %c
+  %lcm.tmp6 = mul nsw i32 %a, 4
   br label %if.end
 
 if.end:                                           ; preds = %if.else5, %if.then2
-  %x.0 = phi i32 [ %lcm.tmp, %if.then2 ], [ %lcm.tmp7, %if.else5 ]
-  %y.0 = phi i32 [ %lcm.tmp5, %if.then2 ], [ %lcm.tmp8, %if.else5 ]
-  %lcm.tmp9 = add i32 %b, %c
+  %x.0 = phi i32 [ %lcm.tmp1, %if.then2 ], [ %lcm.tmp5, %if.else5 ]
+  %y.0 = phi i32 [ %lcm.tmp4, %if.then2 ], [ %lcm.tmp6, %if.else5 ]
   br label %if.end7
 
 if.end7:                                          ; preds = %if.end, %if.then
-  %x.1 = phi i32 [ %lcm.tmp, %if.then ], [ %x.0, %if.end ]
+  %x.1 = phi i32 [ %lcm.tmp1, %if.then ], [ %x.0, %if.end ]
   %y.1 = phi i32 [ %lcm.tmp2, %if.then ], [ %y.0, %if.end ]
-  %lcm.tmp10 = add i32 %b, %c
-  %lcm.tmp11 = add i32 %x.1, %y.1
-  %add10 = add nsw i32 %lcm.tmp11, %lcm.tmp
+  %add9 = add nsw i32 %x.1, %y.1
+  %add10 = add nsw i32 %add9, %lcm.tmp1
   ret i32 %add10
 }
 
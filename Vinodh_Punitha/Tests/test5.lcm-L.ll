@@ -6,47 +6,41 @@ target triple = "x86_64-pc-linux-gnu"
 ; Function Attrs: noinline nounwind uwtable
 define dso_local i32 @complex_cfg(i32 noundef %a, i32 noundef %b, i32 noundef %c) #0 {
 entry:
-  %lcm.tmp = add i32 %b, %c
-  %lcm.tmp1 = mul i32 %a, 2
-  %lcm.tmp2 = mul i32 %a, 3
-  %lcm.tmp3 = sub i32 %b, %c
-  %lcm.tmp4 = mul i32 %a, 4
   %cmp = icmp sgt i32 %a, 0
   br i1 %cmp, label %if.then, label %if.else
 
 if.then:                                          ; preds = %entry
-  %lcm.tmp5 = add i32 %b, %c
-  %lcm.tmp6 = mul i32 %a, 2
+  %add = add nsw i32 %b, %c
+  %mul = mul nsw i32 %a, 2
   br label %if.end7
 
 if.else:                                          ; preds = %entry
-  %lcm.tmp7 = add i32 %b, %c
   %cmp1 = icmp sgt i32 %b, 0
   br i1 %cmp1, label %if.then2, label %if.else5
 
 if.then2:                                         ; preds = %if.else
-  %lcm.tmp8 = add i32 %b, %c
-  %lcm.tmp9 = mul i32 %a, 3
+  %add3 = add nsw i32 %b, %c
+  %mul4 = mul nsw i32 %a, 3
   br label %if.end
 
 if.else5:                                         ; preds = %if.else
-  %lcm.tmp10 = add i32 %b, %c
-  %lcm.tmp11 = sub i32 %b, %c
-  %lcm.tmp12 = mul i32 %a, 4
+  %sub = sub nsw i32 %b, %c
+  %mul6 = mul nsw i32 %a, 4
+  %lcm.tmp = add nsw i32 %b, %c
   br label %if.end
 
 if.end:                                           ; preds = %if.else5, %if.then2
-  %x.0 = phi i32 [ %lcm.tmp, %if.then2 ], [ %lcm.tmp3, %if.else5 ]
-  %y.0 = phi i32 [ %lcm.tmp2, %if.then2 ], [ %lcm.tmp4, %if.else5 ]
-  %lcm.tmp13 = add i32 %b, %c
+  %lcm.phi = phi i32 [ %lcm.tmp, %if.else5 ], [ %add3, %if.then2 ]
+  %x.0 = phi i32 [ %add3, %if.then2 ], [ %sub, %if.else5 ]
+  %y.0 = phi i32 [ %mul4, %if.then2 ], [ %mul6, %if.else5 ]
   br label %if.end7
 
 if.end7:                                          ; preds = %if.end, %if.then
-  %x.1 = phi i32 [ %lcm.tmp, %if.then ], [ %x.0, %if.end ]
-  %y.1 = phi i32 [ %lcm.tmp1, %if.then ], [ %y.0, %if.end ]
-  %lcm.tmp14 = add i32 %b, %c
-  %lcm.tmp15 = add i32 %x.1, %y.1
-  %add10 = add nsw i32 %lcm.tmp15, %lcm.tmp
+  %lcm.phi1 = phi i32 [ %lcm.phi, %if.end ], [ %add, %if.then ]
+  %x.1 = phi i32 [ %add, %if.then ], [ %x.0, %if.end ]
+  %y.1 = phi i32 [ %mul, %if.then ], [ %y.0, %if.end ]
+  %add9 = add nsw i32 %x.1, %y.1
+  %add10 = add nsw i32 %add9, %lcm.phi1
   ret i32 %add10
 }
 
@@ -6,22 +6,21 @@ target triple = "x86_64-pc-linux-gnu"
 ; Function Attrs: noinline nounwind uwtable
 define dso_local i32 @diff_test(i32 noundef %a, i32 noundef %b, i32 noundef %c) #0 {
 entry:
-  %lcm.tmp = add i32 %a, %b
   %cmp = icmp sgt i32 %c, 0
   br i1 %cmp, label %if.then, label %if.else
 
 if.then:                                          ; preds = %entry
-  %lcm.tmp1 = add i32 %a, %b
+  %add = add nsw i32 %a, %b
   br label %if.end
 
 if.else:                                          ; preds = %entry
-  %lcm.tmp2 = add i32 %a, %b
+  %add1 = add nsw i32 %a, %b
   br label %if.end
 
 if.end:                                           ; preds = %if.else, %if.then
-  %x.0 = phi i32 [ %lcm.tmp, %if.then ], [ %lcm.tmp, %if.else ]
-  %lcm.tmp3 = add i32 %x.0, %a
-  ret i32 %lcm.tmp3
+  %x.0 = phi i32 [ %add, %if.then ], [ %add1, %if.else ]
+  %add2 = add nsw i32 %x.0, %a
+  ret i32 %add2
 }
 
 attributes #0 = { noinline nounwind uwtable "frame-pointer"="all" "min-legal-vector-width"="0" "no-trapping-math"="true" "stack-protector-buffer-size"="8" "target-cpu"="x86-64" "target-features"="+cmov,+cx8,+fxsr,+mmx,+sse,+sse2,+x87" "tune-cpu"="generic" }
@@ -17,8 +17,8 @@ if.else:                                          ; preds = %entry
 
 if.end:                                           ; preds = %if.else, %if.then
   %x.0 = phi i32 [ 10, %if.then ], [ 20, %if.else ]
-  %lcm.tmp = add i32 %a, %x.0
-  %mul = mul nsw i32 %lcm.tmp, 2
+  %add = add nsw i32 %a, %x.0
+  %mul = mul nsw i32 %add, 2
   ret i32 %mul
 }
 
@@ -6,55 +6,55 @@ target triple = "x86_64-pc-linux-gnu"
 ; Function Attrs: noinline nounwind uwtable
 define dso_local i32 @test_complex_cfg(i32 noundef %a, i32 noundef %b, i32 noundef %c, i32 noundef %d) #0 {
 entry:
-  %lcm.tmp = add i32 %a, %b
-  %cmp = icmp sgt i32 %a, 10
-  br i1 %cmp, label %if.then, label %if.else8
+  %lcm.tmp = add nsw i32 %a, %b
+  %lcm.tmp1 = icmp sgt i32 %a, 10
+  br i1 %lcm.tmp1, label %if.then, label %if.else8
 
 if.then:                                          ; preds = %entry
-  %lcm.tmp1 = add i32 %c, %d
-  %cmp2 = icmp sgt i32 %b, 5
-  br i1 %cmp2, label %if.then3, label %if.else
+  %lcm.tmp2 = add nsw i32 %c, %d
+  %lcm.tmp3 = icmp sgt i32 %b, 5
+  br i1 %lcm.tmp3, label %if.then3, label %if.else
 
 if.then3:                                         ; preds = %if.then
-  %lcm.tmp2 = mul i32 %lcm.tmp, 2
-  %add5 = add nsw i32 %lcm.tmp1, %lcm.tmp
+  %lcm.tmp4 = mul nsw i32 %lcm.tmp, 2
+  %add5 = add nsw i32 %lcm.tmp2, %lcm.tmp
   br label %if.end
 
 if.else:                                          ; preds = %if.then
-  %lcm.tmp3 = sub i32 %c, %d
-  %sub7 = sub nsw i32 %lcm.tmp1, %lcm.tmp
+  %lcm.tmp5 = sub nsw i32 %c, %d
+  %sub7 = sub nsw i32 %lcm.tmp2, %lcm.tmp
   br label %if.end
 
 if.end:                                           ; preds = %if.else, %if.then3
-  %x.0 = phi i32 [ %lcm.tmp2, %if.then3 ], [ %lcm.tmp3, %if.else ]
+  %x.0 = phi i32 [ %lcm.tmp4, %if.then3 ], [ %lcm.tmp5, %if.else ]
   %y.0 = phi i32 [ %add5, %if.then3 ], [ %sub7, %if.else ]
   br label %if.end19
 
 if.else8:                                         ; preds = %entry
-  %lcm.tmp4 = sub i32 %a, %b
-  %cmp10 = icmp sgt i32 %c, 0
-  br i1 %cmp10, label %if.then11, label %if.else15
+  %lcm.tmp6 = sub nsw i32 %a, %b
+  %lcm.tmp7 = icmp sgt i32 %c, 0
+  br i1 %lcm.tmp7, label %if.then11, label %if.else15
 
 if.then11:                                        ; preds = %if.else8
-  %lcm.tmp5 = add i32 %lcm.tmp, 5
-  %mul14 = mul nsw i32 %lcm.tmp4, %lcm.tmp
+  %lcm.tmp8 = add nsw i32 %lcm.tmp, 5
+  %mul14 = mul nsw i32 %lcm.tmp6, %lcm.tmp
   br label %if.end18
 
 if.else15:                                        ; preds = %if.else8
-  %lcm.tmp6 = sdiv i32 %lcm.tmp4, 2
+  %lcm.tmp9 = sdiv i32 %lcm.tmp6, 2
   %mul17 = mul nsw i32 %lcm.tmp, 3
   br label %if.end18
 
 if.end18:                                         ; preds = %if.else15, %if.then11
-  %x.1 = phi i32 [ %lcm.tmp5, %if.then11 ], [ %mul17, %if.else15 ]
-  %y.1 = phi i32 [ %mul14, %if.then11 ], [ %lcm.tmp6, %if.else15 ]
+  %x.1 = phi i32 [ %lcm.tmp8, %if.then11 ], [ %mul17, %if.else15 ]
+  %y.1 = phi i32 [ %mul14, %if.then11 ], [ %lcm.tmp9, %if.else15 ]
   br label %if.end19
 
 if.end19:                                         ; preds = %if.end18, %if.end
   %x.2 = phi i32 [ %x.0, %if.end ], [ %x.1, %if.end18 ]
   %y.2 = phi i32 [ %y.0, %if.end ], [ %y.1, %if.end18 ]
-  %lcm.tmp7 = add i32 %x.2, %y.2
-  %add22 = add nsw i32 %lcm.tmp7, %lcm.tmp
+  %add21 = add nsw i32 %x.2, %y.2
+  %add22 = add nsw i32 %add21, %lcm.tmp
   ret i32 %add22
 }
 
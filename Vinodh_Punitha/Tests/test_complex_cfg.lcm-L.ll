@@ -6,8 +6,7 @@ target triple = "x86_64-pc-linux-gnu"
 ; Function Attrs: noinline nounwind uwtable
 define dso_local i32 @test_complex_cfg(i32 noundef %a, i32 noundef %b, i32 noundef %c, i32 noundef %d) #0 {
 entry:
-  %lcm.tmp = add i32 %a, %b
-  %lcm.tmp1 = sub i32 %c, %d
+  %add = add nsw i32 %a, %b
   %cmp = icmp sgt i32 %a, 10
   br i1 %cmp, label %if.then, label %if.else8
 
@@ -17,17 +16,17 @@ if.then:                                          ; preds = %entry
   br i1 %cmp2, label %if.then3, label %if.else
 
 if.then3:                                         ; preds = %if.then
-  %lcm.tmp2 = mul i32 %lcm.tmp, 2
-  %add5 = add nsw i32 %add1, %lcm.tmp
+  %mul = mul nsw i32 %add, 2
+  %add5 = add nsw i32 %add1, %add
   br label %if.end
 
 if.else:                                          ; preds = %if.then
-  %lcm.tmp3 = sub i32 %c, %d
-  %sub7 = sub nsw i32 %add1, %lcm.tmp
+  %sub = sub nsw i32 %c, %d
+  %sub7 = sub nsw i32 %add1, %add
   br label %if.end
 
 if.end:                                           ; preds = %if.else, %if.then3
-  %x.0 = phi i32 [ %lcm.tmp2, %if.then3 ], [ %lcm.tmp1, %if.else ]
+  %x.0 = phi i32 [ %mul, %if.then3 ], [ %sub, %if.else ]
   %y.0 = phi i32 [ %add5, %if.then3 ], [ %sub7, %if.else ]
   br label %if.end19
 
@@ -37,25 +36,25 @@ if.else8:                                         ; preds = %entry
   br i1 %cmp10, label %if.then11, label %if.else15
 
 if.then11:                                        ; preds = %if.else8
-  %lcm.tmp4 = add i32 %lcm.tmp, 5
-  %mul14 = mul nsw i32 %sub9, %lcm.tmp
+  %add12 = add nsw i32 %add, 5
+  %mul14 = mul nsw i32 %sub9, %add
   br label %if.end18
 
 if.else15:                                        ; preds = %if.else8
-  %lcm.tmp5 = sdiv i32 %sub9, 2
-  %mul17 = mul nsw i32 %lcm.tmp, 3
+  %mul17 = mul nsw i32 %add, 3
+  %div = sdiv i32 %sub9, 2
   br label %if.end18
 
 if.end18:                                         ; preds = %if.else15, %if.then11
-  %x.1 = phi i32 [ %lcm.tmp4, %if.then11 ], [ %mul17, %if.else15 ]
-  %y.1 = phi i32 [ %mul14, %if.then11 ], [ %lcm.tmp5, %if.else15 ]
+  %x.1 = phi i32 [ %add12, %if.then11 ], [ %mul17, %if.else15 ]
+  %y.1 = phi i32 [ %mul14, %if.then11 ], [ %div, %if.else15 ]
   br label %if.end19
 
 if.end19:                                         ; preds = %if.end18, %if.end
   %x.2 = phi i32 [ %x.0, %if.end ], [ %x.1, %if.end18 ]
   %y.2 = phi i32 [ %y.0, %if.end ], [ %y.1, %if.end18 ]
-  %lcm.tmp6 = add i32 %x.2, %y.2
-  %add22 = add nsw i32 %lcm.tmp6, %lcm.tmp
+  %add21 = add nsw i32 %x.2, %y.2
+  %add22 = add nsw i32 %add21, %add
   ret i32 %add22
 }
 
@@ -6,12 +6,15 @@ target triple = "x86_64-pc-linux-gnu"
 ; Function Attrs: noinline nounwind uwtable
 define dso_local i32 @test_critical_edge_trigger(i32 noundef %a, i32 noundef %b, i32 noundef %c, i32 noundef %p_cond, i32 noundef %q_cond) #0 {
 entry:
-  %lcm.tmp = add i32 %a, %b
   %cmp = icmp sgt i32 %p_cond, 0
-  br i1 %cmp, label %if.then, label %if.end3
+  br i1 %cmp, label %if.then, label %entry.if.end3_crit_edge
+
+entry.if.end3_crit_edge:                          ; preds = %entry
+  %lcm.tmp = add nsw i32 %a, %b
+  br label %if.end3
 
 if.then:                                          ; preds = %entry
-  %lcm.tmp1 = add i32 %a, %b
+  %add = add nsw i32 %a, %b
   %cmp1 = icmp sgt i32 %q_cond, 10
   br i1 %cmp1, label %if.then2, label %if.end
 
@@ -21,13 +24,14 @@ if.then2:                                         ; preds = %if.then
 if.end:                                           ; preds = %if.then
   br label %if.end3
 
-if.end3:                                          ; preds = %if.end, %entry
-  %x.0 = phi i32 [ %lcm.tmp, %if.end ], [ %c, %entry ]
-  %add5 = add nsw i32 %x.0, %lcm.tmp
+if.end3:                                          ; preds = %entry.if.end3_crit_edge, %if.end
+  %lcm.phi = phi i32 [ %lcm.tmp, %entry.if.end3_crit_edge ], [ %add, %if.end ]
+  %x.0 = phi i32 [ %add, %if.end ], [ %c, %entry.if.end3_crit_edge ]
+  %add5 = add nsw i32 %x.0, %lcm.phi
   br label %return
 
 return:                                           ; preds = %if.end3, %if.then2
-  %retval.0 = phi i32 [ %lcm.tmp, %if.then2 ], [ %add5, %if.end3 ]
+  %retval.0 = phi i32 [ %add, %if.then2 ], [ %add5, %if.end3 ]
   ret i32 %retval.0
 }
 
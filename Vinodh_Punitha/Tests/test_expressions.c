@@ -0,0 +1,27 @@
+// test_expressions.c
+void check(int d);
+
+int test_expressions(int a, int b, double f, int c) {
+    int s = a + b;
+    int t = b + a;     // Same expression as a + b (commuted)
+    int lt = a < b;
+    int gt = b > a;    // Same compare as a < b (swapped predicate)
+    long w = (long)a * 2;
+    long v = (long)a;  // Same sext
+    double n = -f;
+    double m = -f;     // Same fneg
+    int u = s * c;
+    int x = t * c;     // Same value as s * c, but a different expression unless value numbered
+
+    int q;
+    if (c > 0) {
+        check(b);      // May not return: a / b must not be computed before it
+        q = a / b;
+    } else {
+        q = a / b;
+    }
+    // Fully redundant on both paths; partially anticipated above the call only
+    int r = a / b;
+
+    return s + t + lt + gt + (int)(w + v) + (int)(n + m) + u + x + q + r;
+}
@@ -0,0 +1,68 @@
+; ModuleID = 'Tests/test_expressions.mem2reg.bc'
+source_filename = "Tests/test_expressions.c"
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-pc-linux-gnu"
+
+; Function Attrs: noinline nounwind uwtable
+define dso_local i32 @test_expressions(i32 noundef %a, i32 noundef %b, double noundef %f, i32 noundef %c) #0 {
+entry:
+  %lcm.tmp = add nsw i32 %a, %b
+  %lcm.tmp1 = icmp slt i32 %a, %b
+  %lcm.tmp2 = sext i32 %a to i64
+  %lcm.tmp3 = fneg double %f
+  %lcm.tmp4 = icmp sgt i32 %c, 0
+  %conv = zext i1 %lcm.tmp1 to i32
+  %conv3 = zext i1 %lcm.tmp1 to i32
+  %mul = mul nsw i64 %lcm.tmp2, 2
+  %mul7 = mul nsw i32 %lcm.tmp, %c
+  %mul8 = mul nsw i32 %lcm.tmp, %c
+  br i1 %lcm.tmp4, label %if.then, label %if.else
+
+if.then:                                          ; preds = %entry
+  %lcm.tmp5 = add nsw i32 %lcm.tmp, %lcm.tmp
+  %lcm.tmp6 = add nsw i64 %mul, %lcm.tmp2
+  %lcm.tmp7 = fadd double %lcm.tmp3, %lcm.tmp3
+  call void @check(i32 noundef %b)
+  %div = sdiv i32 %a, %b
+  br label %if.end
+
+if.else:                                          ; preds = %entry
+  %lcm.tmp8 = sdiv i32 %a, %b
+  %lcm.tmp9 = add nsw i32 %lcm.tmp, %lcm.tmp
+  %lcm.tmp10 = add nsw i64 %mul, %lcm.tmp2
+  %lcm.tmp11 = fadd double %lcm.tmp3, %lcm.tmp3
+  br label %if.end
+
+if.end:                                           ; preds = %if.else, %if.then
+  %lcm.phi14 = phi i32 [ %lcm.tmp8, %if.else ], [ %div, %if.then ]
+  %lcm.phi13 = phi double [ %lcm.tmp11, %if.else ], [ %lcm.tmp7, %if.then ]
+  %lcm.phi12 = phi i64 [ %lcm.tmp10, %if.else ], [ %lcm.tmp6, %if.then ]
+  %lcm.phi = phi i32 [ %lcm.tmp9, %if.else ], [ %lcm.tmp5, %if.then ]
+  %q.0 = phi i32 [ %div, %if.then ], [ %lcm.tmp8, %if.else ]
+  %add13 = add nsw i32 %lcm.phi, %conv
+  %add14 = add nsw i32 %add13, %conv3
+  %conv16 = trunc i64 %lcm.phi12 to i32
+  %add17 = add nsw i32 %add14, %conv16
+  %conv19 = fptosi double %lcm.phi13 to i32
+  %add20 = add nsw i32 %add17, %conv19
+  %add21 = add nsw i32 %add20, %mul7
+  %add22 = add nsw i32 %add21, %mul8
+  %add23 = add nsw i32 %add22, %q.0
+  %add24 = add nsw i32 %add23, %lcm.phi14
+  ret i32 %add24
+}
+
+declare void @check(i32 noundef) #1
+
+attributes #0 = { noinline nounwind uwtable "frame-pointer"="all" "min-legal-vector-width"="0" "no-trapping-math"="true" "stack-protector-buffer-size"="8" "target-cpu"="x86-64" "target-features"="+cmov,+cx8,+fxsr,+mmx,+sse,+sse2,+x87" "tune-cpu"="generic" }
+attributes #1 = { "frame-pointer"="all" "no-trapping-math"="true" "stack-protector-buffer-size"="8" "target-cpu"="x86-64" "target-features"="+cmov,+cx8,+fxsr,+mmx,+sse,+sse2,+x87" "tune-cpu"="generic" }
+
+!llvm.module.flags = !{!0, !1, !2, !3, !4}
+!llvm.ident = !{!5}
+
+!0 = !{i32 1, !"wchar_size", i32 4}
+!1 = !{i32 8, !"PIC Level", i32 2}
+!2 = !{i32 7, !"PIE Level", i32 2}
+!3 = !{i32 7, !"uwtable", i32 2}
+!4 = !{i32 7, !"frame-pointer", i32 2}
+!5 = !{!"Ubuntu clang version 17.0.6 (++20231209124227+6009708b4367-1~exp1~20231209124336.77)"}
@@ -0,0 +1,60 @@
+; ModuleID = 'Tests/test_expressions.mem2reg.bc'
+source_filename = "Tests/test_expressions.c"
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-pc-linux-gnu"
+
+; Function Attrs: noinline nounwind uwtable
+define dso_local i32 @test_expressions(i32 noundef %a, i32 noundef %b, double noundef %f, i32 noundef %c) #0 {
+entry:
+  %add = add nsw i32 %a, %b
+  %cmp = icmp slt i32 %a, %b
+  %conv = zext i1 %cmp to i32
+  %conv4 = sext i32 %a to i64
+  %mul = mul nsw i64 %conv4, 2
+  %fneg = fneg double %f
+  %mul7 = mul nsw i32 %add, %c
+  %cmp9 = icmp sgt i32 %c, 0
+  br i1 %cmp9, label %if.then, label %if.else
+
+if.then:                                          ; preds = %entry
+  call void @check(i32 noundef %b)
+  %div = sdiv i32 %a, %b
+  br label %if.end
+
+if.else:                                          ; preds = %entry
+  %div10 = sdiv i32 %a, %b
+  br label %if.end
+
+if.end:                                           ; preds = %if.else, %if.then
+  %lcm.phi = phi i32 [ %div10, %if.else ], [ %div, %if.then ]
+  %q.0 = phi i32 [ %div, %if.then ], [ %div10, %if.else ]
+  %add12 = add nsw i32 %add, %add
+  %add13 = add nsw i32 %add12, %conv
+  %add14 = add nsw i32 %add13, %conv
+  %add15 = add nsw i64 %mul, %conv4
+  %conv16 = trunc i64 %add15 to i32
+  %add17 = add nsw i32 %add14, %conv16
+  %add18 = fadd double %fneg, %fneg
+  %conv19 = fptosi double %add18 to i32
+  %add20 = add nsw i32 %add17, %conv19
+  %add21 = add nsw i32 %add20, %mul7
+  %add22 = add nsw i32 %add21, %mul7
+  %add23 = add nsw i32 %add22, %q.0
+  %add24 = add nsw i32 %add23, %lcm.phi
+  ret i32 %add24
+}
+
+declare void @check(i32 noundef) #1
+
+attributes #0 = { noinline nounwind uwtable "frame-pointer"="all" "min-legal-vector-width"="0" "no-trapping-math"="true" "stack-protector-buffer-size"="8" "target-cpu"="x86-64" "target-features"="+cmov,+cx8,+fxsr,+mmx,+sse,+sse2,+x87" "tune-cpu"="generic" }
+attributes #1 = { "frame-pointer"="all" "no-trapping-math"="true" "stack-protector-buffer-size"="8" "target-cpu"="x86-64" "target-features"="+cmov,+cx8,+fxsr,+mmx,+sse,+sse2,+x87" "tune-cpu"="generic" }
+
+!llvm.module.flags = !{!0, !1, !2, !3, !4}
+!llvm.ident = !{!5}
+
+!0 = !{i32 1, !"wchar_size", i32 4}
+!1 = !{i32 8, !"PIC Level", i32 2}
+!2 = !{i32 7, !"PIE Level", i32 2}
+!3 = !{i32 7, !"uwtable", i32 2}
+!4 = !{i32 7, !"frame-pointer", i32 2}
+!5 = !{!"Ubuntu clang version 17.0.6 (++20231209124227+6009708b4367-1~exp1~20231209124336.77)"}
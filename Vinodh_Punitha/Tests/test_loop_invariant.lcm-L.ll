@@ -0,0 +1,65 @@
+; ModuleID = 'Tests/test_loop_invariant.mem2reg.bc'
+source_filename = "Tests/test_loop_invariant.c"
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-pc-linux-gnu"
+
+; Function Attrs: noinline nounwind uwtable
+define dso_local i32 @test_loop_invariant(i32 noundef %a, i32 noundef %b, i32 noundef %n) #0 {
+entry:
+  br label %for.cond
+
+for.cond:                                         ; preds = %for.inc, %entry
+  %sum.0 = phi i32 [ 0, %entry ], [ %add1, %for.inc ]
+  %i.0 = phi i32 [ 0, %entry ], [ %inc, %for.inc ]
+  %cmp = icmp slt i32 %i.0, %n
+  br i1 %cmp, label %for.body, label %for.end
+
+for.body:                                         ; preds = %for.cond
+  %add = add nsw i32 %a, %b
+  %mul = mul nsw i32 %add, %i.0
+  %add1 = add nsw i32 %sum.0, %mul
+  br label %for.inc
+
+for.inc:                                          ; preds = %for.body
+  %inc = add nsw i32 %i.0, 1
+  br label %for.cond, !llvm.loop !6
+
+for.end:                                          ; preds = %for.cond
+  ret i32 %sum.0
+}
+
+; Function Attrs: noinline nounwind uwtable
+define dso_local i32 @test_loop_invariant_simple(i32 noundef %a, i32 noundef %b, i32 noundef %n) #0 {
+entry:
+  %add = add nsw i32 %a, %b
+  br label %while.cond
+
+while.cond:                                       ; preds = %while.body, %entry
+  %res.0 = phi i32 [ 0, %entry ], [ %add1, %while.body ]
+  %i.0 = phi i32 [ 0, %entry ], [ %inc, %while.body ]
+  %cmp = icmp slt i32 %i.0, %n
+  br i1 %cmp, label %while.body, label %while.end
+
+while.body:                                       ; preds = %while.cond
+  %add1 = add nsw i32 %res.0, %add
+  %inc = add nsw i32 %i.0, 1
+  br label %while.cond, !llvm.loop !8
+
+while.end:                                        ; preds = %while.cond
+  ret i32 %res.0
+}
+
+attributes #0 = { noinline nounwind uwtable "frame-pointer"="all" "min-legal-vector-width"="0" "no-trapping-math"="true" "stack-protector-buffer-size"="8" "target-cpu"="x86-64" "target-features"="+cmov,+cx8,+fxsr,+mmx,+sse,+sse2,+x87" "tune-cpu"="generic" }
+
+!llvm.module.flags = !{!0, !1, !2, !3, !4}
+!llvm.ident = !{!5}
+
+!0 = !{i32 1, !"wchar_size", i32 4}
+!1 = !{i32 8, !"PIC Level", i32 2}
+!2 = !{i32 7, !"PIE Level", i32 2}
+!3 = !{i32 7, !"uwtable", i32 2}
+!4 = !{i32 7, !"frame-pointer", i32 2}
+!5 = !{!"Ubuntu clang version 17.0.6 (++20231209124227+6009708b4367-1~exp1~20231209124336.77)"}
+!6 = distinct !{!6, !7}
+!7 = !{!"llvm.loop.mustprogress"}
+!8 = distinct !{!8, !7}
@@ -0,0 +1,25 @@
+// test_null_guard.c
+int test_null_guard(int *p) {
+    int x = 0;
+    if (p != 0)
+        x = *p;     // Only loaded when p is not null: nothing may load *p in entry
+    return x;
+}
+
+int test_null_guard_twice(int *p, int c) {
+    if (p == 0)
+        return 0;
+    int x = *p;
+    if (c)
+        x += *p;    // Fully redundant: nothing stores to memory in between
+    return x;
+}
+
+int test_null_guard_loop(int *p, int n) {
+    int s = 0;
+    if (p != 0) {
+        for (int i = 0; i < n; i++)
+            s += *p;  // Invariant, but the loop may not run: *p stays in it
+    }
+    return s;
+}
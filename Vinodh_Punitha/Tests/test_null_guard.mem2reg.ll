@@ -0,0 +1,95 @@
+; ModuleID = 'Tests/test_null_guard.mem2reg.bc'
+source_filename = "Tests/test_null_guard.c"
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-pc-linux-gnu"
+
+; Function Attrs: noinline nounwind uwtable
+define dso_local i32 @test_null_guard(ptr noundef %p) #0 {
+entry:
+  %cmp = icmp ne ptr %p, null
+  br i1 %cmp, label %if.then, label %if.end
+
+if.then:                                          ; preds = %entry
+  %0 = load i32, ptr %p, align 4
+  br label %if.end
+
+if.end:                                           ; preds = %if.then, %entry
+  %x.0 = phi i32 [ %0, %if.then ], [ 0, %entry ]
+  ret i32 %x.0
+}
+
+; Function Attrs: noinline nounwind uwtable
+; Function Attrs: noinline nounwind uwtable
+define dso_local i32 @test_null_guard_twice(ptr noundef %p, i32 noundef %c) #0 {
+entry:
+  %cmp = icmp eq ptr %p, null
+  br i1 %cmp, label %if.then, label %if.end
+
+if.then:                                          ; preds = %entry
+  br label %return
+
+if.end:                                           ; preds = %entry
+  %0 = load i32, ptr %p, align 4
+  %tobool = icmp ne i32 %c, 0
+  br i1 %tobool, label %if.then1, label %if.end2
+
+if.then1:                                         ; preds = %if.end
+  %1 = load i32, ptr %p, align 4
+  %add = add nsw i32 %0, %1
+  br label %if.end2
+
+if.end2:                                          ; preds = %if.then1, %if.end
+  %x.0 = phi i32 [ %add, %if.then1 ], [ %0, %if.end ]
+  br label %return
+
+return:                                           ; preds = %if.end2, %if.then
+  %retval.0 = phi i32 [ 0, %if.then ], [ %x.0, %if.end2 ]
+  ret i32 %retval.0
+}
+
+; Function Attrs: noinline nounwind uwtable
+; Function Attrs: noinline nounwind uwtable
+define dso_local i32 @test_null_guard_loop(ptr noundef %p, i32 noundef %n) #0 {
+entry:
+  %cmp = icmp ne ptr %p, null
+  br i1 %cmp, label %if.then, label %if.end
+
+if.then:                                          ; preds = %entry
+  br label %for.cond
+
+for.cond:                                         ; preds = %for.inc, %if.then
+  %s.0 = phi i32 [ 0, %if.then ], [ %add, %for.inc ]
+  %i.0 = phi i32 [ 0, %if.then ], [ %inc, %for.inc ]
+  %cmp1 = icmp slt i32 %i.0, %n
+  br i1 %cmp1, label %for.body, label %for.end
+
+for.body:                                         ; preds = %for.cond
+  %0 = load i32, ptr %p, align 4
+  %add = add nsw i32 %s.0, %0
+  br label %for.inc
+
+for.inc:                                          ; preds = %for.body
+  %inc = add nsw i32 %i.0, 1
+  br label %for.cond, !llvm.loop !6
+
+for.end:                                          ; preds = %for.cond
+  br label %if.end
+
+if.end:                                           ; preds = %for.end, %entry
+  %s.1 = phi i32 [ %s.0, %for.end ], [ 0, %entry ]
+  ret i32 %s.1
+}
+
+attributes #0 = { noinline nounwind uwtable "frame-pointer"="all" "min-legal-vector-width"="0" "no-trapping-math"="true" "stack-protector-buffer-size"="8" "target-cpu"="x86-64" "target-features"="+cmov,+cx8,+fxsr,+mmx,+sse,+sse2,+x87" "tune-cpu"="generic" }
+
+!llvm.module.flags = !{!0, !1, !2, !3, !4}
+!llvm.ident = !{!5}
+
+!0 = !{i32 1, !"wchar_size", i32 4}
+!1 = !{i32 8, !"PIC Level", i32 2}
+!2 = !{i32 7, !"PIE Level", i32 2}
+!3 = !{i32 7, !"uwtable", i32 2}
+!4 = !{i32 7, !"frame-pointer", i32 2}
+!5 = !{!"Ubuntu clang version 17.0.6 (++20231209124227+6009708b4367-1~exp1~20231209124336.77)"}
+!6 = distinct !{!6, !7}
+!7 = !{!"llvm.loop.mustprogress"}
@@ -6,23 +6,22 @@ target triple = "x86_64-pc-linux-gnu"
 ; Function Attrs: noinline nounwind uwtable
 define dso_local i32 @test_partial_redundancy(i32 noundef %a, i32 noundef %b, i32 noundef %c) #0 {
 entry:
-  %lcm.tmp = mul i32 %c, 10
-  %lcm.tmp1 = add i32 %a, %b
+  %mul = mul nsw i32 %c, 10
   %cmp = icmp sgt i32 %a, 5
   br i1 %cmp, label %if.then, label %if.else
 
 if.then:                                          ; preds = %entry
-  %lcm.tmp2 = add i32 %a, %b
+  %add = add nsw i32 %a, %b
   br label %if.end
 
 if.else:                                          ; preds = %entry
-  %lcm.tmp3 = add i32 %a, %b
+  %lcm.tmp = add nsw i32 %a, %b
   br label %if.end
 
 if.end:                                           ; preds = %if.else, %if.then
-  %y.0 = phi i32 [ %lcm.tmp1, %if.then ], [ %c, %if.else ]
-  %lcm.tmp4 = add i32 %a, %b
-  %add2 = add nsw i32 %y.0, %lcm.tmp1
+  %lcm.phi = phi i32 [ %lcm.tmp, %if.else ], [ %add, %if.then ]
+  %y.0 = phi i32 [ %add, %if.then ], [ %c, %if.else ]
+  %add2 = add nsw i32 %y.0, %lcm.phi
   ret i32 %add2
 }
 
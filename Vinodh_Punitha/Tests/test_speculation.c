@@ -0,0 +1,13 @@
+// test_speculation.c
+int test_speculation(int a, int b, int n) {
+    int sum = 0;
+    for (int i = 0; i < n; i++) {
+        // a * b is computed on one path through the loop only: lcm must leave
+        // it there, mcpre may compute it once before the loop instead
+        if (i & 1)
+            sum += a * b;
+        else
+            sum -= i;
+    }
+    return sum;
+}
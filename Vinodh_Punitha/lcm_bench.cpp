@@ -0,0 +1,148 @@
+/**
+ * lcm_bench.cpp - Stage timings of the LCM pass on synthetic functions
+ *
+ * Builds functions of a chosen size and shape in memory with the generator of
+ * lcm-irgen (lcm_irgen.h), runs the analyses and lcm on each through a
+ * FunctionAnalysisManager (unifiedpass.h; the pass is linked in) and writes the
+ * time of every stage (the -lcm-time-stages timers of unifiedpass.cpp) to CSV
+ * or JSON, one record per size, so runs can be compared across commits and sizes.
+ *
+ *   lcm-bench -blocks=1000,10000,100000 -shape=loops -loop-depth=2 -exprs-per-block=4 -density=50 -o lcm-bench.csv
+ */
+
+#include "unifiedpass.h"
+#include "lcm_irgen.h"
+
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <chrono>
+#include <vector>
+
+using namespace llvm;
+using namespace UnifiedPass;
+
+static cl::OptionCategory BenchCategory("lcm-bench options");
+
+static cl::list<unsigned> Blocks(
+    "blocks", cl::CommaSeparated, cl::cat(BenchCategory),
+    cl::desc("Function sizes in blocks, one record each (default 256,1024,4096)"));
+static cl::opt<unsigned> Repeat(
+    "repeat", cl::init(3), cl::cat(BenchCategory),
+    cl::desc("Runs per size; the fastest time of each stage is reported"));
+static cl::opt<std::string> OutputFile(
+    "o", cl::init("-"), cl::value_desc("file"), cl::cat(BenchCategory),
+    cl::desc("Output file (default stdout)"));
+enum OutputFormat { CSV, JSON };
+static cl::opt<OutputFormat> Format(
+    "format", cl::init(CSV), cl::cat(BenchCategory), cl::desc("Output format"),
+    cl::values(clEnumValN(CSV, "csv", "One line per size, one column per stage"),
+               clEnumValN(JSON, "json", "One object per size with a \"stages\" object")));
+
+namespace {
+
+struct Record {
+    unsigned requestedBlocks = 0, blocks = 0, expressions = 0;
+    double stages[NumLCMStages];
+    double total = 0;
+};
+
+double seconds(std::chrono::steady_clock::duration d) { return std::chrono::duration<double>(d).count(); }
+
+// One run over a fresh function; keeps the fastest time of each stage in R
+void runOnce(unsigned numBlocks, Record &R, bool first) {
+    LLVMContext Ctx;
+    Module M("lcm-bench", Ctx);
+    Function *F = IRGen::Generator(M, IRGen::Seed).build("bench", numBlocks);
+
+    PassBuilder PB;
+    FunctionAnalysisManager FAM;
+    PB.registerFunctionAnalyses(FAM);
+    registerAnalyses(FAM);
+
+    for (unsigned s = 0; s < NumLCMStages; ++s) stageTimer((LCMStage)s)->clear();
+    auto start = std::chrono::steady_clock::now();
+    R.expressions = runLazyCodeMotion(*F, FAM);
+    double total = seconds(std::chrono::steady_clock::now() - start);
+
+    if (verifyFunction(*F, &errs())) report_fatal_error("lcm-bench: lcm produced invalid IR");
+    R.requestedBlocks = numBlocks; R.blocks = F->size();
+    for (unsigned s = 0; s < NumLCMStages; ++s) {
+        Timer *T = stageTimer((LCMStage)s);
+        double t = T->getTotalTime().getWallTime();
+        R.stages[s] = first ? t : std::min(R.stages[s], t);
+        T->clear(); // Nothing left to report at exit
+    }
+    R.total = first ? total : std::min(R.total, total);
+}
+
+void writeCSV(raw_ostream &OS, ArrayRef<Record> records) {
+    OS << "blocks,blocks_after,shape,redundancy,loop_depth,exprs_per_block,density,expressions";
+    for (unsigned s = 0; s < NumLCMStages; ++s) OS << "," << stageTimer((LCMStage)s)->getName();
+    OS << ",total\n";
+    for (const Record &R : records) {
+        OS << R.requestedBlocks << "," << R.blocks << "," << IRGen::ShapeNames[IRGen::ShapeOpt] << ","
+           << IRGen::RedundancyNames[IRGen::RedundancyOpt] << "," << IRGen::LoopDepth << ","
+           << IRGen::ExprsPerBlock << "," << IRGen::Density << "," << R.expressions;
+        for (double t : R.stages) OS << "," << format("%.6f", t);
+        OS << "," << format("%.6f", R.total) << "\n";
+    }
+}
+
+void writeJSON(raw_ostream &OS, ArrayRef<Record> records) {
+    json::OStream J(OS, 2);
+    J.array([&] {
+        for (const Record &R : records) {
+            J.object([&] {
+                J.attribute("blocks", R.requestedBlocks);
+                J.attribute("blocks_after", R.blocks);
+                J.attribute("shape", IRGen::ShapeNames[IRGen::ShapeOpt]);
+                J.attribute("redundancy", IRGen::RedundancyNames[IRGen::RedundancyOpt]);
+                J.attribute("loop_depth", (unsigned)IRGen::LoopDepth);
+                J.attribute("exprs_per_block", (unsigned)IRGen::ExprsPerBlock);
+                J.attribute("density", (unsigned)IRGen::Density);
+                J.attribute("expressions", R.expressions);
+                J.attributeObject("stages", [&] {
+                    for (unsigned s = 0; s < NumLCMStages; ++s)
+                        J.attribute(stageTimer((LCMStage)s)->getName(), R.stages[s]);
+                });
+                J.attribute("total", R.total);
+            });
+        }
+    });
+    OS << "\n";
+}
+
+} // end anonymous namespace
+
+int main(int argc, char **argv) {
+    InitLLVM X(argc, argv);
+    cl::HideUnrelatedOptions({&BenchCategory, &IRGen::ShapeCategory});
+    cl::ParseCommandLineOptions(argc, argv, "Times the stages of lazy code motion on synthetic functions\n");
+    if (Blocks.empty()) { for (unsigned n : {256u, 1024u, 4096u}) Blocks.push_back(n); }
+    TimeStages = true;
+
+    std::vector<Record> records;
+    for (unsigned numBlocks : Blocks) {
+        Record R;
+        for (unsigned i = 0; i < std::max(1u, (unsigned)Repeat); ++i) runOnce(numBlocks, R, i == 0);
+        errs() << "lcm-bench: " << R.blocks << " blocks, " << R.expressions << " expressions: "
+               << format("%.3f", R.total) << "s\n";
+        records.push_back(R);
+    }
+
+    std::error_code EC;
+    raw_fd_ostream OS(OutputFile, EC, sys::fs::OF_Text);
+    if (EC) { errs() << "lcm-bench: " << OutputFile << ": " << EC.message() << "\n"; return 1; }
+    if (Format == JSON) writeJSON(OS, records);
+    else writeCSV(OS, records);
+    return 0;
+}
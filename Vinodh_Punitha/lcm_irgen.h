@@ -0,0 +1,316 @@
+/**
+ * lcm_irgen.h - Synthetic functions for stress and scaling tests of the LCM pass
+ *
+ * A generated function is a chain of regions of one shape (or a random mix of
+ * them) until it has the requested number of blocks:
+ *
+ *   diamond      if-then-else, or an if-then whose skipping edge is critical
+ *   loops        loop nests of -loop-depth with a diamond in the innermost body
+ *   irreducible  a two-block cycle entered at both blocks
+ *   critical     three blocks wired so that three of their five edges are critical
+ *   switch       a -switch-width way switch; every third case jumps straight
+ *                to the merge, so those edges are critical
+ *
+ * Every block computes -exprs-per-block binary operators on the arguments,
+ * -density percent of them drawn from a small function-wide pool (so they repeat
+ * at random) and the rest unique. On top of that each region computes
+ * -patterns expressions in a fixed -redundancy pattern:
+ *
+ *   full       before the region's branch and again at its merge
+ *   partial    on some of the paths into the merge and again at the merge
+ *   invariant  in every loop body (and both blocks of an irreducible cycle)
+ *
+ * Loops count up to -trip-count, so the functions terminate when they are run.
+ * Every value nothing else uses is xor-ed into an accumulator that a phi in
+ * every block carries along, and the function returns it, so none of the
+ * computations are dead and the result depends on all of them.
+ * The same options and -seed give the same function.
+ *
+ * Shared by lcm-irgen (writes the IR) and lcm-bench (times lcm on it); both
+ * link lcm_irgen_options.cpp for the options.
+ */
+#ifndef LCM_IRGEN_H
+#define LCM_IRGEN_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/CommandLine.h"
+
+#include <random>
+#include <vector>
+
+namespace IRGen {
+using namespace llvm;
+
+enum Shape { DiamondShape, LoopShape, IrreducibleShape, CriticalShape, SwitchShape, MixedShape };
+enum Redundancy { NoRedundancy, FullRedundancy, PartialRedundancy, LoopInvariant, MixedRedundancy };
+
+// The shape options, defined in lcm_irgen_options.cpp
+extern const char *const ShapeNames[];
+extern const char *const RedundancyNames[];
+
+extern cl::OptionCategory ShapeCategory;
+
+extern cl::opt<Shape> ShapeOpt;
+extern cl::opt<Redundancy> RedundancyOpt;
+extern cl::opt<unsigned> LoopDepth;
+extern cl::opt<unsigned> SwitchWidth;
+extern cl::opt<unsigned> TripCount;
+extern cl::opt<unsigned> ExprsPerBlock;
+extern cl::opt<unsigned> Density;
+extern cl::opt<unsigned> Patterns;
+extern cl::opt<unsigned> NumArgs;
+extern cl::opt<unsigned> Seed;
+
+class Generator {
+public:
+    Generator(Module &M, unsigned seed) : M(M), Ctx(M.getContext()), rng(seed) {}
+
+    // A function of at least numBlocks blocks in M, returning i64 of i64 arguments
+    Function *build(const Twine &name, unsigned numBlocks) {
+        Type *I64 = Type::getInt64Ty(Ctx);
+        F = Function::Create(FunctionType::get(I64, SmallVector<Type*, 8>(std::max(1u, (unsigned)NumArgs), I64), false),
+                             Function::ExternalLinkage, name, M);
+        args.clear();
+        for (Argument &A : F->args()) args.push_back(&A);
+
+        static const Instruction::BinaryOps Ops[] = {Instruction::Add, Instruction::Mul, Instruction::Xor, Instruction::Sub};
+        pool.clear();
+        for (unsigned i = 0, n = std::max(1u, ExprsPerBlock * 4); i < n; ++i)
+            pool.push_back({Ops[rng() % 4], pick(), pick()});
+
+        BasicBlock *open = newBlock("entry");
+        while (F->size() < numBlocks) open = region(open, ShapeOpt);
+        Value *result = accumulate(open);
+        IRBuilder<>(open).CreateRet(result);
+        return F;
+    }
+
+    // "i32 main()" calling every function in Fs once, so the module runs under lli;
+    // it exits with the xor of their results, to compare runs before and after a pass
+    static Function *buildMain(Module &M, ArrayRef<Function*> Fs) {
+        LLVMContext &Ctx = M.getContext();
+        Function *Main = Function::Create(FunctionType::get(Type::getInt32Ty(Ctx), false),
+                                          Function::ExternalLinkage, "main", M);
+        IRBuilder<> B(BasicBlock::Create(Ctx, "entry", Main));
+        Value *result = B.getInt64(0);
+        for (Function *G : Fs) {
+            SmallVector<Value*, 8> callArgs;
+            for (Argument &A : G->args()) callArgs.push_back(ConstantInt::get(A.getType(), A.getArgNo() + 1));
+            result = B.CreateXor(result, B.CreateCall(G, callArgs));
+        }
+        B.CreateRet(B.CreateTrunc(result, B.getInt32Ty()));
+        return Main;
+    }
+
+private:
+    struct PoolExpr { Instruction::BinaryOps op; Value *lhs, *rhs; };
+
+    // The redundancy of one region: its pattern and the pool expressions placed in it
+    struct Pattern {
+        Redundancy kind;
+        SmallVector<unsigned, 4> exprs;
+    };
+
+    Module &M; LLVMContext &Ctx; std::mt19937 rng;
+    Function *F = nullptr;
+    std::vector<Value*> args;
+    std::vector<PoolExpr> pool;
+
+    Value *pick() { return args[rng() % args.size()]; }
+
+    // A block with its -exprs-per-block operators and no terminator yet
+    BasicBlock *newBlock(const Twine &name) {
+        BasicBlock *BB = BasicBlock::Create(Ctx, name, F);
+        IRBuilder<> B(BB);
+        Value *last = pick();
+        for (unsigned i = 0; i < ExprsPerBlock; ++i) {
+            if (rng() % 100 < Density) {
+                const PoolExpr &E = pool[rng() % pool.size()];
+                B.CreateBinOp(E.op, E.lhs, E.rhs);
+            } else {
+                last = B.CreateBinOp(Instruction::Add, last, pick()); // Chained, so unique
+            }
+        }
+        return BB;
+    }
+
+    // Computes the pattern's expressions at the end of BB, before its terminator if it has one
+    void place(BasicBlock *BB, const Pattern &P) {
+        IRBuilder<> B(Ctx);
+        if (Instruction *T = BB->getTerminator()) B.SetInsertPoint(T);
+        else B.SetInsertPoint(BB);
+        for (unsigned e : P.exprs) B.CreateBinOp(pool[e].op, pool[e].lhs, pool[e].rhs);
+    }
+
+    // Folds the operators nothing uses into an accumulator: a phi at the top of
+    // every block but the entry, xor-ed with them before the terminator. Returns
+    // its value at the end of 'last' (still unterminated).
+    Value *accumulate(BasicBlock *last) {
+        Type *I64 = Type::getInt64Ty(Ctx);
+        DenseMap<BasicBlock*, Value*> accOut;
+        SmallVector<PHINode*, 64> phis;
+        for (BasicBlock &BB : *F) {
+            SmallVector<Instruction*, 8> unused;
+            for (Instruction &I : BB)
+                if (isa<BinaryOperator>(I) && I.use_empty()) unused.push_back(&I);
+            Value *acc = nullptr;
+            if (!BB.isEntryBlock()) {
+                phis.push_back(IRBuilder<>(&BB, BB.begin()).CreatePHI(I64, 2, "acc"));
+                acc = phis.back();
+            }
+            IRBuilder<> B(Ctx);
+            if (Instruction *T = BB.getTerminator()) B.SetInsertPoint(T);
+            else B.SetInsertPoint(&BB);
+            for (Instruction *I : unused) acc = acc ? B.CreateXor(acc, I) : I;
+            accOut[&BB] = acc ? acc : ConstantInt::get(I64, 0);
+        }
+        for (PHINode *Phi : phis)
+            for (BasicBlock *Pred : predecessors(Phi->getParent())) Phi->addIncoming(accOut[Pred], Pred);
+        return accOut[last];
+    }
+
+    void condBr(BasicBlock *from, BasicBlock *ifTrue, BasicBlock *ifFalse) {
+        IRBuilder<> B(from);
+        B.CreateCondBr(B.CreateICmpSLT(pick(), pick()), ifTrue, ifFalse);
+    }
+
+    // A counter phi at the top of BB starting at 0 on the edge from 'entry'
+    PHINode *counter(BasicBlock *BB, BasicBlock *entry) {
+        PHINode *Phi = IRBuilder<>(BB, BB->begin()).CreatePHI(Type::getInt64Ty(Ctx), 2);
+        Phi->addIncoming(ConstantInt::get(Phi->getType(), 0), entry);
+        return Phi;
+    }
+
+    // Increments a counter at the end of BB and branches to ifLess while it is below -trip-count
+    Value *countedBr(BasicBlock *BB, PHINode *Phi, BasicBlock *ifLess, BasicBlock *otherwise) {
+        IRBuilder<> B(BB);
+        Value *next = B.CreateAdd(Phi, ConstantInt::get(Phi->getType(), 1));
+        B.CreateCondBr(B.CreateICmpULT(next, ConstantInt::get(Phi->getType(), TripCount)), ifLess, otherwise);
+        return next;
+    }
+
+    Pattern newPattern() {
+        Pattern P;
+        P.kind = RedundancyOpt == MixedRedundancy ? (Redundancy)(rng() % MixedRedundancy) : (Redundancy)RedundancyOpt;
+        if (P.kind != NoRedundancy)
+            for (unsigned i = 0; i < Patterns; ++i) P.exprs.push_back(rng() % pool.size());
+        return P;
+    }
+
+    // Appends one region after 'open' (unterminated) and returns the new open block
+    BasicBlock *region(BasicBlock *open, Shape S) {
+        if (S == MixedShape) S = (Shape)(rng() % MixedShape);
+        Pattern P = newPattern();
+        switch (S) {
+        case LoopShape:        return loopNest(open, LoopDepth, P);
+        case IrreducibleShape: return irreducible(open, P);
+        case CriticalShape:    return critical(open, P);
+        case SwitchShape:      return switchMerge(open, P);
+        default:               return diamond(open, P);
+        }
+    }
+
+    BasicBlock *diamond(BasicBlock *open, const Pattern &P) {
+        BasicBlock *then = newBlock("then");
+        BasicBlock *join = newBlock("join");
+        if (rng() % 2) {
+            BasicBlock *otherwise = newBlock("else");
+            condBr(open, then, otherwise);
+            IRBuilder<>(otherwise).CreateBr(join);
+        } else {
+            condBr(open, then, join); // open -> join is critical
+        }
+        IRBuilder<>(then).CreateBr(join);
+        if (P.kind == FullRedundancy) place(open, P);
+        if (P.kind == PartialRedundancy) place(then, P);
+        if (P.kind == FullRedundancy || P.kind == PartialRedundancy) place(join, P);
+        return join;
+    }
+
+    // open -> header -> body ... latch -> header | exit, with i = phi [0, open], [i+1, latch]
+    // in the header and the latch looping back while i+1 < -trip-count
+    BasicBlock *loopNest(BasicBlock *open, unsigned depth, const Pattern &P) {
+        if (depth == 0) {
+            // The innermost body: a diamond, or any other acyclic region when mixing
+            Shape S = ShapeOpt == MixedShape ? (Shape)(rng() % MixedShape) : DiamondShape;
+            if (S == LoopShape) S = DiamondShape;
+            return S == IrreducibleShape ? irreducible(open, P)
+                 : S == CriticalShape    ? critical(open, P)
+                 : S == SwitchShape      ? switchMerge(open, P)
+                 : diamond(open, P);
+        }
+        BasicBlock *header = newBlock("header");
+        BasicBlock *body = newBlock("body");
+        BasicBlock *exit = newBlock("exit");
+        IRBuilder<>(open).CreateBr(header);
+        PHINode *i = counter(header, open);
+        if (P.kind == LoopInvariant) place(body, P);
+        BasicBlock *latch = loopNest(body, depth - 1, P);
+        IRBuilder<>(header).CreateBr(body);
+        i->addIncoming(countedBr(latch, i, header, exit), latch);
+        return exit;
+    }
+
+    // open -> a | b; a <-> b, each leaving to exit once its counter reaches -trip-count
+    BasicBlock *irreducible(BasicBlock *open, const Pattern &P) {
+        BasicBlock *a = newBlock("irr.a");
+        BasicBlock *b = newBlock("irr.b");
+        BasicBlock *exit = newBlock("irr.exit");
+        condBr(open, a, b);
+        PHINode *i = counter(a, open), *j = counter(b, open);
+        Value *iNext = countedBr(a, i, b, exit);
+        Value *jNext = countedBr(b, j, a, exit);
+        i->addIncoming(jNext, b);
+        j->addIncoming(iNext, a);
+        if (P.kind == FullRedundancy) place(open, P);
+        if (P.kind == PartialRedundancy || P.kind == LoopInvariant) place(a, P);
+        if (P.kind == LoopInvariant) place(b, P);
+        if (P.kind == FullRedundancy || P.kind == PartialRedundancy) place(exit, P);
+        return exit;
+    }
+
+    // open -> a | b; a -> b | join; b -> join: open -> b, a -> b and a -> join are critical
+    BasicBlock *critical(BasicBlock *open, const Pattern &P) {
+        BasicBlock *a = newBlock("crit.a");
+        BasicBlock *b = newBlock("crit.b");
+        BasicBlock *join = newBlock("crit.join");
+        condBr(open, a, b);
+        condBr(a, b, join);
+        IRBuilder<>(b).CreateBr(join);
+        if (P.kind == FullRedundancy) place(open, P);
+        if (P.kind == PartialRedundancy) place(a, P);
+        if (P.kind == FullRedundancy || P.kind == PartialRedundancy) place(join, P);
+        return join;
+    }
+
+    // switch (arg urem width): case blocks and every third case directly into one merge
+    BasicBlock *switchMerge(BasicBlock *open, const Pattern &P) {
+        unsigned width = std::max(1u, (unsigned)SwitchWidth);
+        BasicBlock *merge = newBlock("merge");
+        IRBuilder<> B(open);
+        Type *I64 = Type::getInt64Ty(Ctx);
+        SwitchInst *SI = B.CreateSwitch(B.CreateURem(pick(), ConstantInt::get(I64, width)), merge, width);
+        for (unsigned c = 0; c < width; ++c) {
+            if (c % 3 == 2) { SI->addCase(ConstantInt::get(cast<IntegerType>(I64), c), merge); continue; }
+            BasicBlock *arm = newBlock("case");
+            IRBuilder<>(arm).CreateBr(merge);
+            SI->addCase(ConstantInt::get(cast<IntegerType>(I64), c), arm);
+            if (P.kind == PartialRedundancy && c % 2 == 0) place(arm, P);
+        }
+        if (P.kind == FullRedundancy) place(open, P);
+        if (P.kind == FullRedundancy || P.kind == PartialRedundancy) place(merge, P);
+        // Keep the blocks in layout order: merge after the cases
+        merge->moveAfter(&F->back());
+        return merge;
+    }
+};
+
+} // end namespace IRGen
+
+#endif // LCM_IRGEN_H
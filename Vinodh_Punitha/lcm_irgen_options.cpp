@@ -0,0 +1,58 @@
+/**
+ * lcm_irgen_options.cpp - The shape options of the synthetic function generator
+ *
+ * Defined once here so lcm-irgen and lcm-bench each register them once; see
+ * lcm_irgen.h for what they select.
+ */
+
+#include "lcm_irgen.h"
+
+namespace IRGen {
+
+const char *const ShapeNames[] = {"diamond", "loops", "irreducible", "critical", "switch", "mixed"};
+const char *const RedundancyNames[] = {"none", "full", "partial", "invariant", "mixed"};
+
+cl::OptionCategory ShapeCategory("Function shape options");
+
+cl::opt<Shape> ShapeOpt(
+    "shape", cl::init(LoopShape), cl::cat(ShapeCategory), cl::desc("Regions the function is made of"),
+    cl::values(clEnumValN(DiamondShape, "diamond", "If-then-else and if-then diamonds"),
+               clEnumValN(LoopShape, "loops", "Loop nests of -loop-depth around a diamond"),
+               clEnumValN(IrreducibleShape, "irreducible", "Cycles with two entry blocks"),
+               clEnumValN(CriticalShape, "critical", "Blocks joined mostly by critical edges"),
+               clEnumValN(SwitchShape, "switch", "Switches of -switch-width cases into one merge"),
+               clEnumValN(MixedShape, "mixed", "A random shape for every region")));
+cl::opt<Redundancy> RedundancyOpt(
+    "redundancy", cl::init(PartialRedundancy), cl::cat(ShapeCategory),
+    cl::desc("Pattern of the -patterns expressions every region adds"),
+    cl::values(clEnumValN(NoRedundancy, "none", "None, only the random -density repeats"),
+               clEnumValN(FullRedundancy, "full", "Computed before the region and again at its merge"),
+               clEnumValN(PartialRedundancy, "partial", "Computed on some paths and again at the merge"),
+               clEnumValN(LoopInvariant, "invariant", "Computed in every loop body"),
+               clEnumValN(MixedRedundancy, "mixed", "A random pattern for every region")));
+cl::opt<unsigned> LoopDepth(
+    "loop-depth", cl::init(2), cl::cat(ShapeCategory),
+    cl::desc("Depth of the loop nests (0 = a diamond instead)"));
+cl::opt<unsigned> SwitchWidth(
+    "switch-width", cl::init(16), cl::cat(ShapeCategory),
+    cl::desc("Cases of every switch"));
+cl::opt<unsigned> TripCount(
+    "trip-count", cl::init(4), cl::cat(ShapeCategory),
+    cl::desc("Iterations of every loop"));
+cl::opt<unsigned> ExprsPerBlock(
+    "exprs-per-block", cl::init(4), cl::cat(ShapeCategory),
+    cl::desc("Binary operators in every block"));
+cl::opt<unsigned> Density(
+    "density", cl::init(50), cl::cat(ShapeCategory),
+    cl::desc("Percentage of those drawn from a small function-wide pool (redundant), the rest are unique"));
+cl::opt<unsigned> Patterns(
+    "patterns", cl::init(2), cl::cat(ShapeCategory),
+    cl::desc("Expressions every region computes in its -redundancy pattern"));
+cl::opt<unsigned> NumArgs(
+    "args", cl::init(8), cl::cat(ShapeCategory),
+    cl::desc("Function arguments the expressions are built from"));
+cl::opt<unsigned> Seed(
+    "seed", cl::init(1), cl::cat(ShapeCategory),
+    cl::desc("Random seed; the same seed and options give the same functions"));
+
+} // end namespace IRGen
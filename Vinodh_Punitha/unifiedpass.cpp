@@ -3,11 +3,16 @@
  *
  */
 
+#include "unifiedpass.h"
+
 // LLVM Headers
 #include "llvm/ADT/BitVector.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/PostOrderIterator.h" // RPO for value numbering (-lcm-value-numbering)
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"     // STATISTIC counters (-stats)
 #include "llvm/Config/llvm-config.h" // Needed for LLVM_EXTERNAL_VISIBILITY, LLVM_VERSION_STRING
 #include "llvm/IR/Argument.h"       // For isa<Argument> in getShortValueName
 #include "llvm/IR/CFG.h"            // For predecessor/successor iteration
@@ -16,6 +21,7 @@
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/Instruction.h"
 #include "llvm/IR/Instructions.h"   // Specifically for BinaryOperator etc., PHINode
+#include "llvm/IR/IntrinsicInst.h"  // Intrinsic expressions (smin, umax, ...)
 #include "llvm/IR/IRBuilder.h"      // Needed for inserting instructions
 #include "llvm/IR/PassManager.h"    // For new Pass Manager integration
 #include "llvm/IR/ValueMap.h"
@@ -23,12 +29,28 @@
 #include "llvm/Passes/PassBuilder.h"
 #include "llvm/Passes/PassPlugin.h"
 #include "llvm/Support/Casting.h"       // For dyn_cast
+#include "llvm/Support/CommandLine.h"   // For cl::opt
+#include "llvm/Support/Debug.h"         // LLVM_DEBUG / -debug-only=lcm
+#include "llvm/Support/ErrorHandling.h" // report_fatal_error (-lcm-verify-updates)
 #include "llvm/Support/raw_ostream.h"   // For printing (outs(), errs())
+#include "llvm/Support/ThreadPool.h"    // Worker pool of the module-level driver
+#include "llvm/Support/Threading.h"     // hardware_concurrency
+#include "llvm/Support/Timer.h"         // Per-stage timers (-lcm-time-stages, lcm-bench)
 #include "llvm/ADT/Hashing.h"       // For hash_combine
 #include "llvm/Analysis/AliasAnalysis.h" // Included for FunctionAnalysisManager
 #include "llvm/Support/Compiler.h" // For LLVM_ATTRIBUTE_UNUSED
 #include "llvm/IR/Dominators.h" // *** CORRECTED Include Path for DominatorTree/Analysis ***
 #include "llvm/Transforms/Utils/Local.h" // For RecursivelyDeleteTriviallyDeadInstructions
+#include "llvm/Transforms/Utils/BasicBlockUtils.h" // For SplitCriticalEdge
+#include "llvm/Transforms/Utils/ModuleUtils.h" // appendToGlobalDtors (lcm-count)
+#include "llvm/Analysis/CFG.h"          // For isCriticalEdge
+#include "llvm/Analysis/BlockFrequencyInfo.h"   // Block frequencies (mcpre)
+#include "llvm/Analysis/BranchProbabilityInfo.h"
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/Analysis/LoopIterator.h"      // Loop bodies in RPO (-lcm-loop-aware)
+#include "llvm/Analysis/ValueTracking.h"     // isSafeToSpeculativelyExecute, isGuaranteedToTransferExecutionToSuccessor
+#include "llvm/Analysis/IteratedDominanceFrontier.h" // Phis for the occurrences mcpre makes redundant
+#include "llvm/Analysis/MemorySSA.h"     // Clobbers of load expressions (-lcm-loads)
 
 // Standard Library Headers
 #include <functional>
@@ -40,6 +62,8 @@
 #include <memory>   // For unique_ptr
 #include <cassert>  // For assert
 #include <algorithm> // For std::find_if
+#include <queue>     // For the dataflow priority worklist
+#include <optional>  // Per-function results of the module-level driver
 
 // Demangling for readable pass names (optional but helpful)
 #ifdef __GNUG__
@@ -64,6 +88,69 @@ std::string demangle(const char* name) {
 using namespace llvm;
 using namespace std;
 
+#define DEBUG_TYPE "lcm"
+
+//==================== DIAGNOSTICS ====================//
+// -lcm-verbose selects what the pass writes to outs():
+//   0  nothing (default)
+//   1  one summary line per transformed function
+//   2  + phase headers and every insertion, replacement and deletion
+//   3  + the dataflow tables and per-block LCM sets
+// The print-* pipelines always print their tables. Finer traces go through
+// LLVM_DEBUG (-debug-only=lcm) and the counters through STATISTIC (-stats).
+static cl::opt<unsigned> LCMVerbose(
+    "lcm-verbose", cl::init(0),
+    cl::desc("Lazy code motion diagnostics level (0 = silent, 1 = summary, 2 = transformations, 3 = dataflow tables)"));
+
+// Runs the statement(s) only at the given verbosity, so the default path formats nothing
+#define LCM_LOG(LEVEL, ...) do { if (LCMVerbose >= (LEVEL)) { __VA_ARGS__; } } while (false)
+
+STATISTIC(NumExpressions, "Number of expressions in the LCM domains");
+STATISTIC(NumInserted, "Number of temporaries inserted by LCM");
+STATISTIC(NumSkippedInsertions, "Number of expressions LCM left in place for lack of an insertion point");
+STATISTIC(NumPhis, "Number of PHIs created by LCM");
+STATISTIC(NumUsesReplaced, "Number of uses rewritten to LCM temporaries");
+STATISTIC(NumDeleted, "Number of redundant computations deleted by LCM");
+STATISTIC(NumEdgesSplit, "Number of critical edges split for LCM placement");
+STATISTIC(NumLoopHoisted, "Number of loop invariants hoisted to preheaders by LCM (-lcm-loop-aware)");
+STATISTIC(NumSSAPREInserted, "Number of computations inserted by SSAPRE");
+STATISTIC(NumSSAPREPhis, "Number of PHIs created by SSAPRE");
+STATISTIC(NumSSAPREDeleted, "Number of redundant computations deleted by SSAPRE");
+STATISTIC(NumMCPREInserted, "Number of computations inserted by MC-PRE");
+STATISTIC(NumMCPREPhis, "Number of PHIs created by MC-PRE");
+STATISTIC(NumMCPREDeleted, "Number of redundant computations deleted by MC-PRE");
+
+// -lcm-time-stages times every stage of lcm separately and reports the times at
+// exit, like -time-passes does for whole passes. lcm-bench reads the same timers.
+namespace UnifiedPass {
+
+cl::opt<bool> TimeStages(
+    "lcm-time-stages", cl::init(false),
+    cl::desc("Time each stage of lazy code motion and report the times at exit"));
+
+Timer *stageTimer(LCMStage S) {
+    if (!TimeStages) return nullptr;
+    static const char *const Names[NumLCMStages][2] = {
+        {"domain", "Expression domain"},
+        {"avail-genkill", "AVAIL GEN/KILL"}, {"avail-solve", "AVAIL solve"},
+        {"anticip-genkill", "ANTIC GEN/KILL"}, {"anticip-solve", "ANTIC solve"},
+        {"used-genkill", "USED GEN/KILL"}, {"used-solve", "USED solve"},
+        {"postpon-genkill", "POSTPONABLE GEN/KILL"}, {"postpon-solve", "POSTPONABLE solve"},
+        {"earliest", "EARLIEST"}, {"latest", "LATER"}, {"insert", "INSERT/DELETE"},
+        {"phase1", "Phase 1: insertion"}, {"phase2", "Phase 2: values and phis"}, {"phase3", "Phase 3: rewrite and deletion"},
+    };
+    static TimerGroup Group("lcm", "Lazy code motion stages");
+    static Timer Timers[NumLCMStages];
+    static bool Initialized = [] {
+        for (unsigned i = 0; i < NumLCMStages; ++i) Timers[i].init(Names[i][0], Names[i][1], Group);
+        return true;
+    }();
+    (void)Initialized;
+    return &Timers[S];
+}
+
+} // end namespace UnifiedPass
+
 //==================== UTILITY CODE ====================//
 // ... (getShortValueName, Expression, DenseMapInfo<Expression> ) ...
 // Corrected getShortValueName function
@@ -89,44 +176,92 @@ std::string getShortValueName(Value *v) {
 
 
 // Define Expression class fully BEFORE DenseMapInfo specialization
+// An expression is an opcode (plus a compare predicate or intrinsic ID), a
+// result type and its operands: binary and unary operators, compares, casts,
+// selects and intrinsics that neither touch memory nor trap. The operands of
+// a commutative operation are compared in address order (a compare swapping
+// its predicate with them), so a+b and b+a are one expression; ops keeps the
+// order of the first occurrence, which is what gets printed and copied.
 class Expression {
     // Helper constants for DenseMap markers
     static const Value* EmptyMarker;
     static const Value* TombstoneMarker;
 
 public:
-  Value *v1 = nullptr; Value *v2 = nullptr; Instruction::BinaryOps op;
+  unsigned op = 0;           // Instruction opcode, 0 if none
+  unsigned pred = 0;         // CmpInst predicate, Intrinsic::ID or load alignment, 0 for the other kinds
+  Type *type = nullptr;      // Result type (casts of one value to two types differ only here)
+  SmallVector<Value*, 3> ops;
+  bool commutes = false;     // The first two operands may be swapped
   Instruction* definingInst = nullptr; // Keep track of the original instruction if created from one
 
-  Expression() : v1(nullptr), v2(nullptr), op(Instruction::BinaryOpsEnd), definingInst(nullptr) {}
+  Expression() = default;
 
-  Expression(Instruction *I) : v1(nullptr), v2(nullptr), op(Instruction::BinaryOpsEnd), definingInst(nullptr) {
+  Expression(Instruction *I) {
     if (I == reinterpret_cast<Instruction*>(const_cast<Value*>(EmptyMarker)) ||
         I == reinterpret_cast<Instruction*>(const_cast<Value*>(TombstoneMarker)) ||
-        !I) {
+        !I || !(isCandidate(*I) || isLoad(*I))) {
         return;
     }
-    if (auto *BO = dyn_cast<BinaryOperator>(I)) {
-        v1 = BO->getOperand(0); v2 = BO->getOperand(1); op = BO->getOpcode(); definingInst = I;
-    }
+    op = I->getOpcode(); type = I->getType(); definingInst = I;
+    if (auto *Cmp = dyn_cast<CmpInst>(I)) pred = Cmp->getPredicate();
+    else if (auto *II = dyn_cast<IntrinsicInst>(I)) pred = II->getIntrinsicID();
+    else if (auto *LI = dyn_cast<LoadInst>(I)) pred = LI->getAlign().value(); // A temporary keeps its alignment
+    if (auto *Call = dyn_cast<CallInst>(I)) ops.append(Call->arg_begin(), Call->arg_end());
+    else ops.append(I->op_begin(), I->op_end());
+    commutes = (isa<CmpInst>(I) || I->isCommutative()) && ops.size() >= 2;
+  }
+
+  explicit Expression(int marker_type) {
+      if (marker_type == 0) { ops.push_back(const_cast<Value*>(EmptyMarker)); }
+      else if (marker_type == 1) { ops.push_back(const_cast<Value*>(TombstoneMarker)); }
+  }
+
+  // Does I compute an expression? Anything with memory effects, a token or
+  // metadata operand, or an intrinsic that may trap stays out. Division and
+  // remainder may trap too but are kept: lcm, ssapre and mcpre only compute them
+  // where every path goes on to, with no call that may not return in between
+  // (see ExpressionDomain::stoppedBy), and the loop hoist leaves them alone.
+  static bool isCandidate(const Instruction &I) {
+      if (isa<BinaryOperator>(&I) || isa<UnaryOperator>(&I) || isa<CmpInst>(&I) || isa<CastInst>(&I) || isa<SelectInst>(&I))
+          return true;
+      auto *II = dyn_cast<IntrinsicInst>(&I);
+      if (!II || isa<DbgInfoIntrinsic>(II) || II->getType()->isVoidTy() || II->getType()->isTokenTy() ||
+          II->hasOperandBundles() || !II->doesNotAccessMemory() || !isSafeToSpeculativelyExecute(II))
+          return false;
+      return none_of(II->args(), [](const Use &U) { return U->getType()->isMetadataTy() || U->getType()->isTokenTy(); });
   }
 
-  explicit Expression(int marker_type) : v1(nullptr), v2(nullptr), op(Instruction::BinaryOpsEnd), definingInst(nullptr) {
-      if (marker_type == 0) { v1 = const_cast<Value*>(EmptyMarker); }
-      else if (marker_type == 1) { v1 = const_cast<Value*>(TombstoneMarker); }
+  // Loads that are neither volatile nor atomic, expressions only under
+  // -lcm-loads, where the domain also knows what may clobber them
+  static bool isLoad(const Instruction &I) {
+      auto *LI = dyn_cast<LoadInst>(&I);
+      return LI && LI->isSimple();
   }
 
   bool isValid() const {
-      return v1 != const_cast<Value*>(EmptyMarker) && v1 != const_cast<Value*>(TombstoneMarker) && v1 != nullptr && v2 != nullptr && op != Instruction::BinaryOps::BinaryOpsEnd;
+      return !ops.empty() && ops[0] != const_cast<Value*>(EmptyMarker) && ops[0] != const_cast<Value*>(TombstoneMarker) &&
+             ops[0] != nullptr && op != 0;
+  }
+  bool isEmptyKey() const { return !ops.empty() && ops[0] == const_cast<Value*>(EmptyMarker); }
+  bool isTombstoneKey() const { return !ops.empty() && ops[0] == const_cast<Value*>(TombstoneMarker); }
+
+  // Predicate and first two operands in canonical order
+  std::tuple<unsigned, Value*, Value*> head() const {
+      Value *a = ops[0], *b = ops.size() > 1 ? ops[1] : nullptr;
+      if (!commutes || !std::less<Value*>()(b, a)) return {pred, a, b};
+      bool isCmp = op == Instruction::ICmp || op == Instruction::FCmp;
+      return {isCmp ? (unsigned)CmpInst::getSwappedPredicate((CmpInst::Predicate)pred) : pred, b, a};
   }
-  bool isEmptyKey() const { return v1 == const_cast<Value*>(EmptyMarker); }
-  bool isTombstoneKey() const { return v1 == const_cast<Value*>(TombstoneMarker); }
 
   struct Hash {
       size_t operator()(const Expression& e) const {
           if (e.isEmptyKey()) return static_cast<size_t>(-1);
           if (e.isTombstoneKey()) return static_cast<size_t>(-2);
-          return hash_combine((size_t)e.op, hash_value(e.v1), hash_value(e.v2));
+          auto [p, a, b] = e.head();
+          size_t h = hash_combine((size_t)e.op, p, e.type, a, b);
+          for (unsigned i = 2; i < e.ops.size(); ++i) h = hash_combine(h, e.ops[i]);
+          return h;
       }
   };
 
@@ -134,7 +269,9 @@ public:
       if (isEmptyKey()) return e2.isEmptyKey();
       if (isTombstoneKey()) return e2.isTombstoneKey();
       if (e2.isEmptyKey() || e2.isTombstoneKey()) return false;
-      return (op == e2.op && v1 == e2.v1 && v2 == e2.v2);
+      if (!isValid() || !e2.isValid()) return !isValid() && !e2.isValid();
+      return op == e2.op && type == e2.type && ops.size() == e2.ops.size() && head() == e2.head() &&
+             std::equal(ops.begin() + std::min<size_t>(2, ops.size()), ops.end(), e2.ops.begin() + std::min<size_t>(2, ops.size()));
   }
 
   bool operator<(const Expression &e2) const {
@@ -145,8 +282,24 @@ public:
         return false;
     }
     if (op != e2.op) return op < e2.op;
-    if (v1 != e2.v1) return v1 < e2.v1;
-    return v2 < e2.v2;
+    if (type != e2.type) return std::less<Type*>()(type, e2.type);
+    if (head() != e2.head()) return head() < e2.head();
+    auto rest = [](const Expression &e) { return ArrayRef<Value*>(e.ops).drop_front(std::min<size_t>(2, e.ops.size())); };
+    return std::lexicographical_compare(rest(*this).begin(), rest(*this).end(), rest(e2).begin(), rest(e2).end(), std::less<Value*>());
+  }
+
+  // A new instruction computing the expression before InsertBefore: a copy of
+  // the first occurrence over the key's operands (value numbering may have
+  // replaced them), without its metadata, carrying that occurrence's
+  // wrap/exact/fast-math flags until the caller intersects them with the
+  // occurrences the copy replaces
+  Instruction *materialize(Instruction *InsertBefore, const Twine &Name) const {
+      Instruction *I = definingInst->clone();
+      for (unsigned i = 0; i < ops.size(); ++i) I->setOperand(i, ops[i]); // A call's arguments come first too
+      I->dropUnknownNonDebugMetadata();
+      I->setName(Name);
+      I->insertBefore(InsertBefore);
+      return I;
   }
 
   std::string toString() const {
@@ -161,9 +314,22 @@ public:
       case Instruction::URem: opStr = "%u"; break; case Instruction::Shl: opStr = "<<"; break;
       case Instruction::LShr: opStr = ">>l"; break; case Instruction::AShr: opStr = ">>a"; break;
       case Instruction::And: opStr = "&"; break; case Instruction::Or: opStr = "|"; break;
-      case Instruction::Xor: opStr = "^"; break; default: opStr = "<op" + std::to_string(op) + ">"; break;
+      case Instruction::Xor: opStr = "^"; break; default: break;
     }
-    return getShortValueName(v1) + " " + opStr + " " + getShortValueName(v2);
+    if (!opStr.empty()) return getShortValueName(ops[0]) + " " + opStr + " " + getShortValueName(ops[1]);
+
+    // Other kinds: "icmp slt a, b", "zext a to i64", "smin(a, b)"
+    std::string s; raw_string_ostream strm(s);
+    if (op == Instruction::Call) strm << Intrinsic::getBaseName((Intrinsic::ID)pred) << "(";
+    else {
+        strm << Instruction::getOpcodeName(op);
+        if (op == Instruction::ICmp || op == Instruction::FCmp) strm << " " << CmpInst::getPredicateName((CmpInst::Predicate)pred);
+        strm << " ";
+    }
+    for (unsigned i = 0; i < ops.size(); ++i) strm << (i ? ", " : "") << getShortValueName(ops[i]);
+    if (op == Instruction::Call) strm << ")";
+    else if (Instruction::isCast(op)) strm << " to " << *type;
+    return strm.str();
   }
 };
 
@@ -180,154 +346,735 @@ template <> struct DenseMapInfo<Expression> {
 } // namespace llvm
 
 
+//==================== BIT MATRIX STORAGE ====================//
+// Vector width of the fused kernels below, in words. Picked from the target
+// flags the plugin is built with (-mavx2, -mavx512f or -march=native); other
+// builds run the scalar loop alone.
+#if defined(__AVX512F__)
+#include <immintrin.h>
+#define LCM_SIMD_WORDS 8
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define LCM_SIMD_WORDS 4
+#else
+#define LCM_SIMD_WORDS 1
+#endif
+
+// Fixed-width bit rows in one of two layouts:
+//  Dense  - rows packed back to back in one word array. Row r of an N-column
+//           matrix occupies words [r * wordsPerRow, (r + 1) * wordsPerRow).
+//  Sparse - per row, only the nonzero words as sorted (index, word) pairs,
+//           stored complemented when that needs fewer words, so nearly empty
+//           and nearly full rows both stay small.
+// Bits past the last column read as zero so rows compare word by word.
+// row() is the dense fast path; readRow/rowForWrite/storeRow work in both.
+class BitMatrix {
+public:
+  using Word = uint64_t;
+  static constexpr unsigned BitsPerWord = 64;
+  enum Layout { Dense, Sparse };
+
+  BitMatrix() = default;
+  BitMatrix(unsigned rows, unsigned cols, bool value = false) { assign(rows, cols, value); }
+
+  // Resizes to rows x cols with every bit set to 'value'
+  void assign(unsigned rows, unsigned cols, bool value = false, Layout L = Dense) {
+      nRows = rows; nCols = cols; nWords = wordsFor(cols); layout = L;
+      words.clear(); sparseRows.clear();
+      if (layout == Dense) {
+          words.assign((size_t)nRows * nWords, 0);
+          if (value) { for (unsigned r = 0; r < nRows; ++r) setRow(r, true); }
+      } else {
+          sparseRows.assign(nRows, SparseRow{value, {}});
+      }
+  }
+
+  // Converts the storage in place, keeping the contents
+  void setLayout(Layout L) {
+      if (L == layout) return;
+      BitMatrix converted; converted.assign(nRows, nCols, false, L);
+      SmallVector<Word, 8> scratch(nWords);
+      for (unsigned r = 0; r < nRows; ++r) converted.storeRow(r, readRow(r, scratch.data()));
+      *this = std::move(converted);
+  }
+
+  static unsigned wordsFor(unsigned cols) { return (cols + BitsPerWord - 1) / BitsPerWord; }
+
+  unsigned rows() const { return nRows; }
+  unsigned cols() const { return nCols; }
+  unsigned wordsPerRow() const { return nWords; }
+  Layout getLayout() const { return layout; }
+  bool isSparse() const { return layout == Sparse; }
+  // Words actually held (all of them when dense), the fill measure behind the layout choice
+  size_t storedWords() const {
+      if (layout == Dense) return words.size();
+      size_t n = 0; for (const SparseRow &SR : sparseRows) n += SR.entries.size(); return n;
+  }
+
+  // Dense layout only
+  Word *row(unsigned r) { assert(layout == Dense); return words.data() + (size_t)r * nWords; }
+  const Word *row(unsigned r) const { assert(layout == Dense); return words.data() + (size_t)r * nWords; }
+
+  // Row r as wordsPerRow() words: the row itself when dense, else decoded into scratch
+  const Word *readRow(unsigned r, Word *scratch) const {
+      if (layout == Dense) return row(r);
+      const SparseRow &SR = sparseRows[r];
+      std::fill(scratch, scratch + nWords, Word(0));
+      for (auto &[idx, w] : SR.entries) scratch[idx] = w;
+      if (SR.complemented) flipWords(scratch, nCols);
+      return scratch;
+  }
+  // Row r for in-place update: the row itself when dense, else a decoded copy
+  // in scratch for storeRow(r, ...) to write back
+  Word *rowForWrite(unsigned r, Word *scratch) {
+      if (layout == Dense) return row(r);
+      readRow(r, scratch);
+      return scratch;
+  }
+  void storeRow(unsigned r, const Word *src) {
+      if (layout == Dense) { if (src != row(r)) copyWords(row(r), src, nWords); return; }
+      // Keep whichever of the row and its complement has fewer nonzero words
+      unsigned plain = 0, comp = 0;
+      for (unsigned i = 0; i < nWords; ++i) { plain += src[i] != 0; comp += complementWord(src, i) != 0; }
+      SparseRow &SR = sparseRows[r];
+      SR.complemented = comp < plain; SR.entries.clear(); SR.entries.reserve(std::min(plain, comp));
+      for (unsigned i = 0; i < nWords; ++i) {
+          Word w = SR.complemented ? complementWord(src, i) : src[i];
+          if (w) SR.entries.push_back({i, w});
+      }
+  }
+
+  bool test(unsigned r, unsigned c) const {
+      if (layout == Dense) return (row(r)[c / BitsPerWord] >> (c % BitsPerWord)) & 1;
+      const SparseRow &SR = sparseRows[r];
+      return (((storedWord(SR, c / BitsPerWord) >> (c % BitsPerWord)) & 1) != 0) != SR.complemented;
+  }
+  void set(unsigned r, unsigned c) {
+      if (layout == Dense) { row(r)[c / BitsPerWord] |= Word(1) << (c % BitsPerWord); return; }
+      setStoredBit(sparseRows[r], c, !sparseRows[r].complemented);
+  }
+  void reset(unsigned r, unsigned c) {
+      if (layout == Dense) { row(r)[c / BitsPerWord] &= ~(Word(1) << (c % BitsPerWord)); return; }
+      setStoredBit(sparseRows[r], c, sparseRows[r].complemented);
+  }
+
+  void setRow(unsigned r, bool value) {
+      if (layout == Dense) { fillWords(row(r), nCols, value); return; }
+      sparseRows[r] = SparseRow{value, {}};
+  }
+  bool rowNone(unsigned r) const {
+      if (layout == Dense) return noneWords(row(r), nWords);
+      return findFirst(r) == -1;
+  }
+
+  // Index of the first set bit in row r at or after 'from', or -1
+  int findNext(unsigned r, int from) const {
+      if (from < 0 || (unsigned)from >= nCols) return -1;
+      if (layout == Sparse) return findNextSparse(sparseRows[r], from);
+      const Word *w = row(r);
+      unsigned idx = from / BitsPerWord;
+      Word cur = w[idx] & (~Word(0) << (from % BitsPerWord));
+      while (true) {
+          if (cur) return idx * BitsPerWord + __builtin_ctzll(cur);
+          if (++idx >= nWords) return -1;
+          cur = w[idx];
+      }
+  }
+  int findFirst(unsigned r) const { return findNext(r, 0); }
+
+  // Row r with its columns renumbered into dst (wordsFor(newCols) words): column
+  // c moves to newCol[c], or is dropped where that is -1, and the columns no one
+  // moves to stay clear. Walks whichever of the row and its complement is
+  // smaller, word by word, so nearly full rows cost as little as nearly empty ones.
+  void remapRow(unsigned r, ArrayRef<int> newCol, unsigned newCols, const Word *mapped, Word *dst) const {
+      auto move = [&](Word w, unsigned base, bool set) {
+          for (; w; w &= w - 1) {
+              int c = newCol[base + __builtin_ctzll(w)];
+              if (c < 0) continue;
+              Word bit = Word(1) << (c % BitsPerWord);
+              if (set) dst[c / BitsPerWord] |= bit; else dst[c / BitsPerWord] &= ~bit;
+          }
+      };
+      if (layout == Sparse) {
+          const SparseRow &SR = sparseRows[r];
+          // Complemented entries are the clear bits: start from every moved column set
+          if (SR.complemented) copyWords(dst, mapped, wordsFor(newCols)); else fillWords(dst, newCols, false);
+          for (auto &[idx, w] : SR.entries) move(w, idx * BitsPerWord, !SR.complemented);
+          return;
+      }
+      const Word *src = row(r);
+      unsigned ones = 0;
+      for (unsigned i = 0; i < nWords; ++i) ones += __builtin_popcountll(src[i]);
+      if (2 * ones <= nCols) {
+          fillWords(dst, newCols, false);
+          for (unsigned i = 0; i < nWords; ++i) move(src[i], i * BitsPerWord, true);
+      } else {
+          copyWords(dst, mapped, wordsFor(newCols));
+          for (unsigned i = 0; i < nWords; ++i) move(complementWord(src, i), i * BitsPerWord, false);
+      }
+  }
+
+  // --- Word-range helpers shared by the solver policies and LCM ---
+  static void copyWords(Word *dst, const Word *src, unsigned n) { std::copy(src, src + n, dst); }
+  static void andWords(Word *dst, const Word *src, unsigned n) { for (unsigned i = 0; i < n; ++i) dst[i] &= src[i]; }
+  static void orWords(Word *dst, const Word *src, unsigned n) { for (unsigned i = 0; i < n; ++i) dst[i] |= src[i]; }
+  static void andNotWords(Word *dst, const Word *src, unsigned n) { for (unsigned i = 0; i < n; ++i) dst[i] &= ~src[i]; }
+  static bool equalWords(const Word *a, const Word *b, unsigned n) { return std::equal(a, a + n, b); }
+  static bool noneWords(const Word *a, unsigned n) { for (unsigned i = 0; i < n; ++i) if (a[i]) return false; return true; }
+  // Complement of the first 'cols' bits; the unused tail stays zero
+  static void flipWords(Word *dst, unsigned cols) {
+      unsigned n = wordsFor(cols);
+      for (unsigned i = 0; i < n; ++i) dst[i] = ~dst[i];
+      clearTail(dst, cols);
+  }
+  static void fillWords(Word *dst, unsigned cols, bool value) {
+      unsigned n = wordsFor(cols);
+      std::fill(dst, dst + n, value ? ~Word(0) : Word(0));
+      clearTail(dst, cols);
+  }
+
+  // --- Fused kernels: one equation per pass over the words, no temporaries ---
+  // dst = (in & ~kill) | gen (the gen/kill transfer)
+  static void transferWords(Word *dst, const Word *in, const Word *kill, const Word *gen, unsigned n) {
+      mapWords(dst, in, kill, gen, n, [](auto i, auto k, auto g) { return (i & ~k) | g; });
+  }
+  // dst = ~availOut & (kill | ~anticOut) over the first 'cols' bits (EARLIEST on
+  // the out-edges of a block, before the target's ANTIC_IN is applied)
+  static void earliestWords(Word *dst, const Word *availOut, const Word *kill, const Word *anticOut, unsigned cols) {
+      mapWords(dst, availOut, kill, anticOut, wordsFor(cols), [](auto v, auto k, auto a) { return ~v & (k | ~a); });
+      clearTail(dst, cols);
+  }
+  // dst = ~antic | antloc over the first 'cols' bits (the LATER kill)
+  static void laterKillWords(Word *dst, const Word *antic, const Word *antloc, unsigned cols) {
+      mapWords(dst, antic, antloc, antloc, wordsFor(cols), [](auto a, auto l, auto) { return ~a | l; });
+      clearTail(dst, cols);
+  }
+
+private:
+  // dst[i] = fn(a[i], b[i], c[i]). fn uses only the bitwise operators, which
+  // GCC and Clang also accept on the SIMD register types, so one expression
+  // serves the vector body and the scalar tail. dst may alias an input.
+  template <typename Fn>
+  static void mapWords(Word *dst, const Word *a, const Word *b, const Word *c, unsigned n, Fn fn) {
+      unsigned i = 0;
+#if LCM_SIMD_WORDS == 8
+      for (; i + 8 <= n; i += 8)
+          _mm512_storeu_si512(dst + i, fn(_mm512_loadu_si512(a + i), _mm512_loadu_si512(b + i), _mm512_loadu_si512(c + i)));
+#elif LCM_SIMD_WORDS == 4
+      for (; i + 4 <= n; i += 4)
+          _mm256_storeu_si256((__m256i *)(dst + i), fn(_mm256_loadu_si256((const __m256i *)(a + i)),
+                                                       _mm256_loadu_si256((const __m256i *)(b + i)),
+                                                       _mm256_loadu_si256((const __m256i *)(c + i))));
+#endif
+      for (; i < n; ++i) dst[i] = fn(a[i], b[i], c[i]);
+  }
+
+  static void clearTail(Word *dst, unsigned cols) {
+      if (cols % BitsPerWord) dst[cols / BitsPerWord] &= (Word(1) << (cols % BitsPerWord)) - 1;
+  }
+
+  // --- Sparse layout ---
+  struct SparseRow {
+      bool complemented = false;                      // Entries hold ~row
+      std::vector<std::pair<unsigned, Word>> entries; // Nonzero words by ascending index
+  };
+  static std::vector<std::pair<unsigned, Word>>::const_iterator entryAtOrAfter(const SparseRow &SR, unsigned idx) {
+      return llvm::lower_bound(SR.entries, idx, [](const std::pair<unsigned, Word> &E, unsigned i) { return E.first < i; });
+  }
+
+  // Word i of ~src, with the bits past the last column kept clear
+  Word complementWord(const Word *src, unsigned i) const {
+      Word w = ~src[i];
+      if (i == nWords - 1 && nCols % BitsPerWord) w &= (Word(1) << (nCols % BitsPerWord)) - 1;
+      return w;
+  }
+  static Word storedWord(const SparseRow &SR, unsigned idx) {
+      auto it = entryAtOrAfter(SR, idx);
+      return (it != SR.entries.end() && it->first == idx) ? it->second : Word(0);
+  }
+  static void setStoredBit(SparseRow &SR, unsigned c, bool value) {
+      unsigned idx = c / BitsPerWord; Word bit = Word(1) << (c % BitsPerWord);
+      auto it = SR.entries.begin() + (entryAtOrAfter(SR, idx) - SR.entries.begin());
+      if (it != SR.entries.end() && it->first == idx) {
+          it->second = value ? (it->second | bit) : (it->second & ~bit);
+          if (!it->second) SR.entries.erase(it);
+      } else if (value) {
+          SR.entries.insert(it, {idx, bit});
+      }
+  }
+  int findNextSparse(const SparseRow &SR, unsigned from) const {
+      unsigned idx = from / BitsPerWord;
+      Word mask = ~Word(0) << (from % BitsPerWord);
+      auto it = entryAtOrAfter(SR, idx);
+      if (!SR.complemented) {
+          // Set bits live in the entries
+          for (; it != SR.entries.end(); ++it, mask = ~Word(0)) {
+              Word cur = it->first == idx ? (it->second & mask) : it->second;
+              if (cur) return it->first * BitsPerWord + __builtin_ctzll(cur);
+          }
+          return -1;
+      }
+      // Set bits are the clear bits of the entries, and all of every word without one
+      for (; idx < nWords; ++idx, mask = ~Word(0)) {
+          Word stored = (it != SR.entries.end() && it->first == idx) ? (it++)->second : Word(0);
+          Word cur = ~stored & mask;
+          if (idx == nWords - 1 && nCols % BitsPerWord) cur &= (Word(1) << (nCols % BitsPerWord)) - 1;
+          if (cur) return idx * BitsPerWord + __builtin_ctzll(cur);
+      }
+      return -1;
+  }
+
+  unsigned nRows = 0, nCols = 0, nWords = 0;
+  Layout layout = Dense;
+  std::vector<Word> words;            // Dense rows
+  std::vector<SparseRow> sparseRows;  // Sparse rows
+};
+
+
 //==================== DATAFLOW FRAMEWORK CODE ====================//
+// Dense layout-order numbering of a function's blocks with CSR pred/succ lists.
+// Built once per function and shared by every solver and result over that CFG,
+// so row b of any matrix is the same block everywhere.
+class BlockNumbering {
+public:
+  void build(Function &F);
+
+  unsigned getNumBlocks() const { return blocks.size(); }
+  unsigned blockIndex(const BasicBlock *bb) const { return blockIdx.lookup(bb); }
+  int findBlock(const BasicBlock *bb) const { auto it = blockIdx.find(bb); return it == blockIdx.end() ? -1 : (int)it->second; }
+  BasicBlock *getBlock(unsigned idx) const { return blocks[idx]; }
+  ArrayRef<unsigned> predIndices(unsigned idx) const { return ArrayRef<unsigned>(predList).slice(predStart[idx], predStart[idx + 1] - predStart[idx]); }
+  ArrayRef<unsigned> succIndices(unsigned idx) const { return ArrayRef<unsigned>(succList).slice(succStart[idx], succStart[idx + 1] - succStart[idx]); }
+
+private:
+  std::vector<BasicBlock*> blocks; DenseMap<const BasicBlock*, unsigned> blockIdx;
+  std::vector<unsigned> predStart, predList, succStart, succList; // CSR adjacency by block index
+};
+
+void BlockNumbering::build(Function &F) {
+  blocks.clear(); blockIdx.clear();
+  for (BasicBlock &BB : F) { blockIdx[&BB] = blocks.size(); blocks.push_back(&BB); }
+
+  unsigned numBlocks = blocks.size();
+  predStart.assign(numBlocks + 1, 0); succStart.assign(numBlocks + 1, 0);
+  predList.clear(); succList.clear();
+  for (unsigned b = 0; b < numBlocks; ++b) {
+      for (BasicBlock *pred : predecessors(blocks[b])) predList.push_back(blockIdx.lookup(pred));
+      predStart[b + 1] = predList.size();
+      for (BasicBlock *succ : successors(blocks[b])) succList.push_back(blockIdx.lookup(succ));
+      succStart[b + 1] = succList.size();
+  }
+}
+
+// How a changed function's numbering relates to the one a previous fixpoint
+// was computed over, for re-solving only what the change can reach
+// (Dataflow::seed). Built by ExpressionDomain::update.
+struct DomainDelta {
+  std::vector<int> oldBlock; // New block index -> old row, or -1 for a block the change created
+  std::vector<int> newCol;   // Old expression index -> new index, or -1 if it is gone
+  bool sameColumns = false;  // newCol is the identity
+  BitVector fresh;           // New expressions absent before
+  BitVector affected;        // New indices whose GEN/KILL may differ somewhere (includes fresh)
+  BitVector dirty;           // New blocks where they may differ, or whose edges changed
+};
+
+// Layout of the dataflow matrices. Functions whose matrices would be large are
+// built with sparse GEN/KILL first; if those fill few enough of their words, IN
+// and OUT are sparse as well, otherwise everything goes back to dense rows.
+static cl::opt<unsigned> SparseDensityPercent(
+    "lcm-sparse-density", cl::init(2),
+    cl::desc("Use sparse dataflow sets when GEN/KILL fill less than this percentage of their words (0 = always dense)"));
+static cl::opt<unsigned> SparseMinKiB(
+    "lcm-sparse-min-kib", cl::init(1024), cl::Hidden,
+    cl::desc("Consider sparse dataflow sets only when one dense matrix would take at least this many KiB"));
+
+// Direction-independent part of the framework: the IN/OUT/GEN/KILL matrices
+// over a shared block numbering, boundary/initial configuration and the
+// printing helpers. The solver itself is the DataflowSolver template below,
+// specialised per analysis at compile time.
 class Dataflow {
 public:
   enum Direction { FORWARD, BACKWARD };
   enum Initial { EMPTY, ALL };
+  using Word = BitMatrix::Word;
 
-  struct BlockState {
-    BasicBlock *bb = nullptr;
-    BitVector In;
-    BitVector Out;
-    unsigned domainSize = 0;
+  Dataflow(Initial boundary = EMPTY, Initial initial = EMPTY)
+      : boundary(boundary), initial(initial), nBlockBits(0) {}
 
-    void initialize(unsigned size, Initial initialVal) {
-      domainSize = size;
-      if (initialVal == EMPTY) { In = BitVector(size); Out = BitVector(size); }
-      else { In = BitVector(size, true); Out = BitVector(size, true); }
-    }
-  };
+  Dataflow &setBoundary(Initial b) { boundary = b; return *this; }
+  Dataflow &setInitial(Initial i) { initial = i; return *this; }
+  // Caps the number of block visits of run(); 0 means run to the fixpoint
+  Dataflow &setVisitBudget(unsigned visits) { visitBudget = visits; return *this; }
+
+  // Binds the solver to a block numbering and sizes GEN/KILL to 'size' bits.
+  // Must be called before GEN/KILL are filled in and before run().
+  void initializeDomain(const BlockNumbering &numbering, unsigned size);
+
+  // Dense block numbering, identical for every analysis of the same CFG
+  const BlockNumbering &getNumbering() const { return *cfg; }
+  unsigned getNumBlocks() const { return cfg->getNumBlocks(); }
+  unsigned blockIndex(const BasicBlock *bb) const { return cfg->blockIndex(bb); }
+  BasicBlock *getBlock(unsigned idx) const { return cfg->getBlock(idx); }
+  ArrayRef<unsigned> predIndices(unsigned idx) const { return cfg->predIndices(idx); }
+  ArrayRef<unsigned> succIndices(unsigned idx) const { return cfg->succIndices(idx); }
+
+  BitMatrix &gen() { return Gen; }
+  BitMatrix &kill() { return Kill; }
+  const BitMatrix &gen() const { return Gen; }
+  const BitMatrix &kill() const { return Kill; }
+  const BitMatrix &in() const { return In; }
+  const BitMatrix &out() const { return Out; }
+
+  // GEN/KILL row b for the transfer functions, decoded into a solver-owned
+  // buffer when sparse (valid until the next call of the same accessor)
+  const Word *genRow(unsigned b) const { return Gen.readRow(b, genScratch.data()); }
+  const Word *killRow(unsigned b) const { return Kill.readRow(b, killScratch.data()); }
+
+  // Hands the converged IN/OUT matrices over to a longer-lived result
+  void releaseResults(BitMatrix &in, BitMatrix &out) { in = std::move(In); out = std::move(Out); }
+
+  // Incremental re-solve after the change described by Delta: IN/OUT start from
+  // a previous fixpoint (oldIn/oldOut, over the old numbering) with the affected
+  // expressions reset in every block the change can reach. Sets 'region' to those
+  // blocks, whose GEN/KILL rows must be filled in before DataflowSolver::resume().
+  // False, with nothing seeded, if that would reset most of the matrices anyway
+  // (a full run() is cheaper then).
+  bool seed(Direction dir, const DomainDelta &Delta, const BitMatrix &oldIn, const BitMatrix &oldOut, BitVector &region);
+
+  // Convergence statistics of the last run
+  unsigned getNumIterations() const { return numIterations; } // Transfer evaluations
+  unsigned getNumSCCs() const { return numSCCs; }
+  bool hasConverged() const { return converged; } // False only if the visit budget ran out
+
+  static std::string bitVectorExprToString(const BitMatrix &m, unsigned row, const std::vector<Expression> &exprVec, std::string delimiter = ", ") {
+      std::string s = ""; bool first = true;
+      for (int i = m.findFirst(row); i != -1; i = m.findNext(row, i + 1)) {
+          if (!first) { s += delimiter; }
+          if (i < (int)exprVec.size() && exprVec[i].isValid()) {
+             s += exprVec[i].toString();
+          } else {
+             s += "<invalid_idx_or_expr_" + std::to_string(i) + ">";
+          }
+          first = false;
+      } return s;
+  }
+  static std::string bitVectorIndicesToString(const BitMatrix &m, unsigned row) {
+      std::string s = "{"; bool first = true;
+      for (int i = m.findFirst(row); i != -1; i = m.findNext(row, i + 1)) {
+          if (!first) { s += ", "; } s += std::to_string(i); first = false;
+      } s += "}"; return s;
+  }
 
-  using MeetOpFn = std::function<BitVector(BitVector, BitVector)>;
-  using TransferFn = std::function<BitVector(BasicBlock*, const BitVector&)>;
+protected:
+  Initial boundary; Initial initial; unsigned int nBlockBits;
+  const BlockNumbering *cfg = nullptr;
+  BitMatrix In, Out, Gen, Kill;
+  mutable SmallVector<Word, 8> genScratch, killScratch;
+  unsigned numIterations = 0; unsigned numSCCs = 0;
+  unsigned visitBudget = 0; bool converged = false;
+  BitVector resumeFrom; // Blocks resume() starts from, set by seed()
+
+  // Computes the order in which the worklist hands out blocks: SCCs of the CFG
+  // in topological order (reverse topological for BACKWARD), and within each
+  // SCC reverse postorder (postorder for BACKWARD). Returns the number of SCCs.
+  unsigned computeVisitOrder(Direction dir, std::vector<unsigned> &order, std::vector<unsigned> &priority) const;
+
+  // Layout for IN/OUT, from the measured fill of GEN/KILL. Moves GEN/KILL back
+  // to dense rows when the sparse layout does not pay off.
+  BitMatrix::Layout chooseLayout();
+};
 
-  Dataflow(Direction direction = FORWARD, Initial boundary = EMPTY, Initial initial = EMPTY,
-           MeetOpFn meetOp = nullptr, TransferFn transferFn = nullptr)
-      : direction(direction), boundary(boundary), initial(initial),
-        meetOp(meetOp), transferFn(transferFn), nBlockBits(0) {}
+void Dataflow::initializeDomain(const BlockNumbering &numbering, unsigned size) {
+  nBlockBits = size;
+  cfg = &numbering;
+  // Large matrices start sparse; chooseLayout() settles it once GEN/KILL are known
+  uint64_t denseBytes = (uint64_t)getNumBlocks() * BitMatrix::wordsFor(size) * sizeof(Word);
+  BitMatrix::Layout L = (SparseDensityPercent && denseBytes >= (uint64_t)SparseMinKiB * 1024) ? BitMatrix::Sparse : BitMatrix::Dense;
+  Gen.assign(getNumBlocks(), size, false, L); Kill.assign(getNumBlocks(), size, false, L);
+  genScratch.assign(BitMatrix::wordsFor(size), 0); killScratch.assign(BitMatrix::wordsFor(size), 0);
+}
 
-  Dataflow &setDirection(Direction dir) { direction = dir; return *this; }
-  Dataflow &setBoundary(Initial b) { boundary = b; return *this; }
-  Dataflow &setInitial(Initial i) { initial = i; return *this; }
-  Dataflow &setMeetOp(MeetOpFn fn) { meetOp = fn; return *this; }
-  Dataflow &setTransferFn(TransferFn fn) { transferFn = fn; return *this; }
-  Dataflow &setMeetIdentity(const BitVector& identity) { meetIdentity = identity; return *this; }
-
-  void initializeDomain(unsigned size) {
-      nBlockBits = size;
-      if (meetIdentity.empty()) { meetIdentity = (initial == ALL) ? BitVector(nBlockBits, true) : BitVector(nBlockBits); }
-      else if (meetIdentity.size() != size) {
-          meetIdentity.resize(size);
-          meetIdentity = (initial == ALL) ? BitVector(nBlockBits, true) : BitVector(nBlockBits);
+bool Dataflow::seed(Direction dir, const DomainDelta &Delta, const BitMatrix &oldIn, const BitMatrix &oldOut, BitVector &region) {
+  const unsigned numBlocks = getNumBlocks();
+  const unsigned nWords = BitMatrix::wordsFor(nBlockBits);
+  auto downstream = [&](unsigned b) { return dir == FORWARD ? succIndices(b) : predIndices(b); };
+  auto isBoundary = [&](unsigned b) { return dir == FORWARD ? predIndices(b).empty() : succIndices(b).empty(); };
+  auto closure = [&](BitVector &blocks) {
+      SmallVector<unsigned, 32> stack;
+      for (unsigned b : blocks.set_bits()) stack.push_back(b);
+      while (!stack.empty()) {
+          for (unsigned n : downstream(stack.pop_back_val())) { if (!blocks.test(n)) { blocks.set(n); stack.push_back(n); } }
       }
+  };
+
+  // Only blocks downstream of a dirty block can see a different value
+  region = Delta.dirty;
+  closure(region);
+  if (2 * (uint64_t)region.count() * Delta.affected.count() > (uint64_t)numBlocks * nBlockBits) return false;
+
+  // Elsewhere a fresh expression is transparent all the way back to the
+  // boundary: it holds the boundary value where the boundary reaches and the
+  // initial value where it does not (unreachable code, loops without an exit)
+  BitVector fromBoundary(numBlocks);
+  if (Delta.fresh.any() && (boundary == ALL || initial == ALL)) {
+      for (unsigned b = 0; b < numBlocks; ++b) { if (isBoundary(b)) fromBoundary.set(b); }
+      closure(fromBoundary);
   }
 
-  void run(Function &F, StringRef debugName = "");
+  auto maskOf = [&](const BitVector &cols) {
+      SmallVector<Word, 8> mask(nWords, 0);
+      for (unsigned c : cols.set_bits()) mask[c / BitMatrix::BitsPerWord] |= Word(1) << (c % BitMatrix::BitsPerWord);
+      return mask;
+  };
+  SmallVector<Word, 8> affectedMask = maskOf(Delta.affected), freshMask = maskOf(Delta.fresh);
+  BitVector movedCols(nBlockBits, true); movedCols.reset(Delta.fresh);
+  SmallVector<Word, 8> movedMask = maskOf(movedCols); // Columns with an old counterpart
+
+  // Old rows renumbered into the new matrices, which keep the previous layout
+  const BitMatrix::Layout layout = oldIn.getLayout();
+  Gen.setLayout(layout); Kill.setLayout(layout);
+  In.assign(numBlocks, nBlockBits, false, layout); Out.assign(numBlocks, nBlockBits, false, layout);
+  SmallVector<Word, 8> oldBuf(oldIn.wordsPerRow()), rowBuf(nWords);
+  for (auto [M, Old] : {std::make_pair(&In, &oldIn), std::make_pair(&Out, &oldOut)}) {
+      for (unsigned b = 0; b < numBlocks; ++b) {
+          Word *row = M->rowForWrite(b, rowBuf.data());
+          int ob = Delta.oldBlock[b];
+          if (ob < 0) {
+              BitMatrix::fillWords(row, nBlockBits, initial == ALL); // Created by the change
+          } else if (Delta.sameColumns) {
+              BitMatrix::copyWords(row, Old->readRow(ob, oldBuf.data()), nWords);
+          } else {
+              Old->remapRow(ob, Delta.newCol, nBlockBits, movedMask.data(), row);
+          }
+          if (region.test(b)) {
+              if (initial == ALL) BitMatrix::orWords(row, affectedMask.data(), nWords);
+              else BitMatrix::andNotWords(row, affectedMask.data(), nWords);
+          } else if ((fromBoundary.test(b) ? boundary : initial) == ALL) {
+              BitMatrix::orWords(row, freshMask.data(), nWords);
+          }
+          M->storeRow(b, row);
+      }
+  }
+  for (unsigned b = 0; b < numBlocks; ++b) {
+      if (isBoundary(b)) (dir == FORWARD ? In : Out).setRow(b, boundary == ALL); // Never met into
+  }
 
-  DenseMap<BasicBlock *, BlockState> &getStates() { return states; }
-  const DenseMap<BasicBlock *, BlockState> &getStates() const { return states; }
+  // With nothing reset, only the dirty blocks can disagree with their neighbours
+  resumeFrom = Delta.affected.any() ? region : Delta.dirty;
+  return true;
+}
 
-  const BlockState& getState(BasicBlock* bb) const {
-      auto it = states.find(bb);
-      if (it != states.end()) { return it->second; }
-      else { static BlockState dummy; /* Consider initializing dummy */ return dummy; }
+BitMatrix::Layout Dataflow::chooseLayout() {
+  if (!Gen.isSparse()) return BitMatrix::Dense;
+  uint64_t totalWords = 2 * (uint64_t)Gen.rows() * Gen.wordsPerRow();
+  uint64_t filled = Gen.storedWords() + Kill.storedWords();
+  if (filled * 100 < totalWords * SparseDensityPercent) {
+      LLVM_DEBUG(dbgs() << "Dataflow: sparse sets (" << filled << " of " << totalWords << " GEN/KILL words filled)\n");
+      return BitMatrix::Sparse;
   }
+  Gen.setLayout(BitMatrix::Dense); Kill.setLayout(BitMatrix::Dense);
+  return BitMatrix::Dense;
+}
 
-  static std::string bitVectorExprToString( const BitVector &bv, const std::vector<Expression> &exprVec, std::string delimiter = ", ") {
-      std::string s = ""; bool first = true;
-      for(int i = 0; i < bv.size(); ++i) {
-          if (bv[i]) {
-              if (!first) { s += delimiter; }
-              if (i >= 0 && i < (int)exprVec.size() && exprVec[i].isValid()) {
-                 s += exprVec[i].toString();
-              } else {
-                 s += "<invalid_idx_or_expr_" + std::to_string(i) + ">";
+unsigned Dataflow::computeVisitOrder(Direction dir, std::vector<unsigned> &order, std::vector<unsigned> &priority) const {
+  unsigned numBlocks = getNumBlocks();
+  order.clear(); priority.assign(numBlocks, 0);
+  if (numBlocks == 0) return 0;
+
+  // --- Reverse postorder: DFS from the entry (block 0), then from any unreachable block ---
+  std::vector<unsigned> rpoIndex(numBlocks), postorder; postorder.reserve(numBlocks);
+  BitVector visited(numBlocks);
+  SmallVector<std::pair<unsigned, unsigned>, 16> dfsStack; // (block, next successor slot)
+  for (unsigned root = 0; root < numBlocks; ++root) {
+      if (visited.test(root)) continue;
+      visited.set(root); dfsStack.push_back({root, 0});
+      while (!dfsStack.empty()) {
+          unsigned bb = dfsStack.back().first, &slot = dfsStack.back().second;
+          if (slot != succIndices(bb).size()) {
+              unsigned succ = succIndices(bb)[slot++];
+              if (!visited.test(succ)) { visited.set(succ); dfsStack.push_back({succ, 0}); }
+          } else { postorder.push_back(bb); dfsStack.pop_back(); }
+      }
+  }
+  for (unsigned i = 0; i < numBlocks; ++i) rpoIndex[postorder[numBlocks - 1 - i]] = i;
+
+  // --- Tarjan's SCCs (iterative). SCCs are emitted in reverse topological order ---
+  const unsigned Unvisited = ~0u;
+  std::vector<unsigned> sccOf(numBlocks), dfsNum(numBlocks, Unvisited), lowLink(numBlocks);
+  SmallVector<unsigned, 16> tarjanStack; BitVector onStack(numBlocks);
+  unsigned nextNum = 0, nextSCC = 0;
+  for (unsigned root = 0; root < numBlocks; ++root) {
+      if (dfsNum[root] != Unvisited) continue;
+      dfsNum[root] = lowLink[root] = nextNum++; tarjanStack.push_back(root); onStack.set(root);
+      dfsStack.push_back({root, 0});
+      while (!dfsStack.empty()) {
+          unsigned bb = dfsStack.back().first, &slot = dfsStack.back().second;
+          if (slot != succIndices(bb).size()) {
+              unsigned succ = succIndices(bb)[slot++];
+              if (dfsNum[succ] == Unvisited) {
+                  dfsNum[succ] = lowLink[succ] = nextNum++; tarjanStack.push_back(succ); onStack.set(succ);
+                  dfsStack.push_back({succ, 0});
+              } else if (onStack.test(succ)) {
+                  lowLink[bb] = std::min(lowLink[bb], dfsNum[succ]);
               }
-              first = false;
+              continue;
           }
-      } return s;
+          dfsStack.pop_back();
+          if (!dfsStack.empty()) { unsigned parent = dfsStack.back().first; lowLink[parent] = std::min(lowLink[parent], lowLink[bb]); }
+          if (lowLink[bb] == dfsNum[bb]) { // bb is the root of an SCC
+              unsigned member;
+              do { member = tarjanStack.pop_back_val(); onStack.reset(member); sccOf[member] = nextSCC; } while (member != bb);
+              nextSCC++;
+          }
+      }
   }
-  static std::string bitVectorIndicesToString(const BitVector &bv) {
-      std::string s = "{"; bool first = true;
-      for(int i = 0; i < bv.size(); ++i) {
-          if (bv[i]) { if (!first) s += ", "; s += std::to_string(i); first = false; }
-      } s += "}"; return s;
+
+  // --- Order: SCC rank first, then (reverse) postorder inside the SCC ---
+  auto key = [&](unsigned bb) {
+      if (dir == FORWARD) return std::make_pair(nextSCC - 1 - sccOf[bb], rpoIndex[bb]);
+      return std::make_pair(sccOf[bb], numBlocks - 1 - rpoIndex[bb]);
+  };
+  order.resize(numBlocks);
+  for (unsigned i = 0; i < numBlocks; ++i) order[i] = i;
+  std::sort(order.begin(), order.end(), [&](unsigned a, unsigned b) { return key(a) < key(b); });
+  for (unsigned i = 0; i < numBlocks; ++i) priority[order[i]] = i;
+  return nextSCC;
+}
+
+//----------------------------------------------------------------------------
+// Meet policies. 'apply' folds one neighbour's row into the running meet value
+// in place; 'Identity' is the value the running meet starts from.
+//----------------------------------------------------------------------------
+struct IntersectMeet {
+  static constexpr Dataflow::Initial Identity = Dataflow::ALL;
+  static void apply(BitMatrix::Word *acc, const BitMatrix::Word *val, unsigned nWords) { BitMatrix::andWords(acc, val, nWords); }
+};
+
+struct UnionMeet {
+  static constexpr Dataflow::Initial Identity = Dataflow::EMPTY;
+  static void apply(BitMatrix::Word *acc, const BitMatrix::Word *val, unsigned nWords) { BitMatrix::orWords(acc, val, nWords); }
+};
+
+//----------------------------------------------------------------------------
+// Transfer policy for the classic gen/kill problems: Result = (Input - KILL) U GEN,
+// reading the GEN/KILL rows of the solver and writing the destination row in place.
+//----------------------------------------------------------------------------
+struct GenKillTransfer {
+  void operator()(const Dataflow &df, unsigned b, const BitMatrix::Word *input, BitMatrix::Word *result) const {
+      BitMatrix::transferWords(result, input, df.killRow(b), df.genRow(b), df.gen().wordsPerRow());
   }
+};
+
+//----------------------------------------------------------------------------
+// Worklist solver, specialised on direction, meet and transfer at compile time.
+// IN/OUT are rows of the shared matrices and are updated in place; apart from
+// the matrices the only per-run storage is the worklist and one scratch row.
+//----------------------------------------------------------------------------
+template <Dataflow::Direction Dir, typename MeetOp, typename TransferFn>
+class DataflowSolver : public Dataflow {
+public:
+  DataflowSolver(Initial boundary = EMPTY, Initial initial = EMPTY, TransferFn transferFn = TransferFn())
+      : Dataflow(boundary, initial), transferFn(transferFn) {}
+
+  DataflowSolver &setTransferFn(TransferFn fn) { transferFn = fn; return *this; }
+
+  void run(Function &F, StringRef debugName = "");
+
+  // Same, from the state seed() left: visits only the blocks in its region
+  bool seed(const DomainDelta &Delta, const BitMatrix &oldIn, const BitMatrix &oldOut, BitVector &region) {
+      return Dataflow::seed(Dir, Delta, oldIn, oldOut, region);
+  }
+  void resume(Function &F, StringRef debugName = "");
 
 private:
-  Direction direction; Initial boundary; Initial initial; unsigned int nBlockBits;
-  MeetOpFn meetOp; TransferFn transferFn;
-  BitVector meetIdentity;
-  DenseMap<BasicBlock *, BlockState> states;
+  TransferFn transferFn;
+
+  bool checkDomain(Function &F, StringRef debugName) const;
+  void iterate(const BitVector &start);
 };
 
-void Dataflow::run(Function &F, StringRef debugName) {
-  if (nBlockBits == 0) { errs() << "Warning: Dataflow domain size is 0 for " << debugName << ". Analysis not run.\n"; return; }
-  if (!meetOp || !transferFn) { errs() << "Error: Meet or Transfer function not set for " << debugName << ".\n"; return; }
-  if (meetIdentity.size() != nBlockBits) {
-      errs() << "Warning: Meet identity size mismatch for " << debugName << ". Re-initializing based on 'initial'.\n";
-      meetIdentity = (initial == ALL) ? BitVector(nBlockBits, true) : BitVector(nBlockBits);
-  }
+template <Dataflow::Direction Dir, typename MeetOp, typename TransferFn>
+bool DataflowSolver<Dir, MeetOp, TransferFn>::checkDomain(Function &F, StringRef debugName) const {
+  if (nBlockBits == 0) { errs() << "Warning: Dataflow domain size is 0 for " << debugName << ". Analysis not run.\n"; return false; }
+  if (!cfg || getNumBlocks() != F.size()) { errs() << "Error: Dataflow domain not initialised for " << debugName << ".\n"; return false; }
+  return true;
+}
 
-  states.clear(); SmallVector<BasicBlock*, 16> worklist; DenseSet<BasicBlock*> worklistSet;
+template <Dataflow::Direction Dir, typename MeetOp, typename TransferFn>
+void DataflowSolver<Dir, MeetOp, TransferFn>::run(Function &F, StringRef debugName) {
+  if (!checkDomain(F, debugName)) return;
 
-  for (BasicBlock &block : F) {
-    auto [it, inserted] = states.insert({&block, BlockState()});
-    BlockState& state = it->second; state.bb = &block;
-    if (inserted || state.domainSize != nBlockBits) { state.initialize(nBlockBits, initial); }
+  const unsigned numBlocks = getNumBlocks();
+  BitMatrix::Layout layout = chooseLayout();
+  In.assign(numBlocks, nBlockBits, initial == ALL, layout);
+  Out.assign(numBlocks, nBlockBits, initial == ALL, layout);
+  for (unsigned b = 0; b < numBlocks; ++b) {
     // Apply boundary conditions
-    if (direction == FORWARD) { if (pred_begin(&block) == pred_end(&block)) { state.In = (boundary == EMPTY) ? BitVector(nBlockBits) : BitVector(nBlockBits, true); } }
-    else { /* BACKWARD */ if (succ_begin(&block) == succ_end(&block)) { state.Out = (boundary == EMPTY) ? BitVector(nBlockBits) : BitVector(nBlockBits, true); } }
-    // Add to worklist if not already present
-    if (worklistSet.find(&block) == worklistSet.end()) { worklist.push_back(&block); worklistSet.insert(&block); }
+    if (Dir == FORWARD) { if (predIndices(b).empty()) { In.setRow(b, boundary == ALL); } }
+    else { /* BACKWARD */ if (succIndices(b).empty()) { Out.setRow(b, boundary == ALL); } }
   }
+  iterate(BitVector(numBlocks, true));
+}
+
+template <Dataflow::Direction Dir, typename MeetOp, typename TransferFn>
+void DataflowSolver<Dir, MeetOp, TransferFn>::resume(Function &F, StringRef debugName) {
+  if (!checkDomain(F, debugName)) return;
+  iterate(resumeFrom);
+}
+
+template <Dataflow::Direction Dir, typename MeetOp, typename TransferFn>
+void DataflowSolver<Dir, MeetOp, TransferFn>::iterate(const BitVector &start) {
+  const unsigned numBlocks = getNumBlocks();
+  const unsigned nWords = BitMatrix::wordsFor(nBlockBits);
+  numIterations = 0; converged = false;
+
+  // Priority worklist: smallest visit-order index first, bit-set membership
+  std::vector<unsigned> order, priority;
+  numSCCs = computeVisitOrder(Dir, order, priority);
+  std::priority_queue<unsigned, std::vector<unsigned>, std::greater<unsigned>> worklist;
+  BitVector inWorklist(numBlocks);
+  auto enqueue = [&](unsigned b) {
+      unsigned idx = priority[b];
+      if (!inWorklist.test(idx)) { inWorklist.set(idx); worklist.push(idx); }
+  };
+  for (unsigned b : start.set_bits()) enqueue(b);
+
+  // FORWARD: meet into IN over predecessors' OUT, transfer IN -> OUT.
+  // BACKWARD: meet into OUT over successors' IN, transfer OUT -> IN.
+  BitMatrix &meetSide = (Dir == FORWARD) ? In : Out;
+  BitMatrix &resultSide = (Dir == FORWARD) ? Out : In;
+  SmallVector<Word, 8> oldVal(nWords); // Reused across visits for change detection
+  SmallVector<Word, 8> meetBuf(nWords), resultBuf(nWords), neighbourBuf(nWords); // Decoded rows when sparse
 
   while (!worklist.empty()) {
-    BasicBlock *block = worklist.pop_back_val(); worklistSet.erase(block);
-    BlockState &st = states[block]; BitVector oldVal; BitVector currentMeetVal;
-
-    if (direction == FORWARD) {
-      oldVal = st.Out;
-      // Calculate IN = meet(OUT[p]) for all p in predecessors(block)
-      if (pred_begin(block) != pred_end(block)) {
-          currentMeetVal = meetIdentity; // Initialize with meet identity
-          for (BasicBlock *pred : predecessors(block)) {
-              auto pred_it = states.find(pred);
-              if (pred_it != states.end()) { currentMeetVal = meetOp(currentMeetVal, pred_it->second.Out); }
-              else { errs() << "Warning: State not found for predecessor in " << debugName << "\n"; }
-          }
-          st.In = currentMeetVal; // Update IN set
-      } // else: Entry block, IN already set by boundary condition
-
-      // Calculate OUT = transfer(block, IN)
-      st.Out = transferFn(block, st.In);
-
-      // If OUT changed, add successors to worklist
-      if (st.Out != oldVal) { for (BasicBlock *succ : successors(block)) { if (worklistSet.find(succ) == worklistSet.end()) { worklist.push_back(succ); worklistSet.insert(succ); } } }
-    } else { // BACKWARD
-      oldVal = st.In;
-       // Calculate OUT = meet(IN[s]) for all s in successors(block)
-      if (succ_begin(block) != succ_end(block)) {
-          currentMeetVal = meetIdentity; // Initialize with meet identity
-          for (BasicBlock *succ : successors(block)) {
-              auto succ_it = states.find(succ);
-              if (succ_it != states.end()) { currentMeetVal = meetOp(currentMeetVal, succ_it->second.In); }
-              else { errs() << "Warning: State not found for successor in " << debugName << "\n"; }
-          }
-           st.Out = currentMeetVal; // Update OUT set
-      } // else: Exit block, OUT already set by boundary condition
+    if (visitBudget && numIterations >= visitBudget) { return; } // Stopped short of the fixpoint
+    unsigned idx = worklist.top(); worklist.pop(); inWorklist.reset(idx);
+    unsigned b = order[idx];
+    numIterations++;
+
+    ArrayRef<unsigned> meetFrom = (Dir == FORWARD) ? predIndices(b) : succIndices(b);
+    ArrayRef<unsigned> notify = (Dir == FORWARD) ? succIndices(b) : predIndices(b);
+    Word *meetRow = meetSide.rowForWrite(b, meetBuf.data()), *resultRow = resultSide.rowForWrite(b, resultBuf.data());
+
+    BitMatrix::copyWords(oldVal.data(), resultRow, nWords);
+    // Meet over neighbours (blocks without any keep the boundary value)
+    if (!meetFrom.empty()) {
+        BitMatrix::fillWords(meetRow, nBlockBits, MeetOp::Identity == ALL); // Start from the meet identity
+        for (unsigned n : meetFrom) { MeetOp::apply(meetRow, resultSide.readRow(n, neighbourBuf.data()), nWords); }
+        meetSide.storeRow(b, meetRow);
+    }
 
-      // Calculate IN = transfer(block, OUT)
-      st.In = transferFn(block, st.Out);
+    transferFn(*this, b, meetRow, resultRow);
 
-      // If IN changed, add predecessors to worklist
-      if (st.In != oldVal) { for (BasicBlock *pred : predecessors(block)) { if (worklistSet.find(pred) == worklistSet.end()) { worklist.push_back(pred); worklistSet.insert(pred); } } }
+    // If the result changed, store it and revisit the dependent neighbours
+    if (!BitMatrix::equalWords(resultRow, oldVal.data(), nWords)) {
+        resultSide.storeRow(b, resultRow);
+        for (unsigned n : notify) { enqueue(n); }
     }
   }
+  converged = true;
 }
 
-
 //==================== ANALYSIS PASSES (NEW PM STRUCTURE) ====================//
 namespace UnifiedPass {
 
@@ -337,22 +1084,326 @@ class UsedExpressions;
 class PostponableExpressions; // Forward declaration
 class LazyCodeMotion;
 
-// Base class for Analysis Passes
-class AnalysisPassBase {
-public:
-    // Common domain representation
-    std::map<Expression, int> exprMap;
-    std::vector<Expression> exprVec;
+//-----------------------------------------------------------------------------
+// 0) Expression Domain Analysis (New PM)
+//-----------------------------------------------------------------------------
+// Marker set for passes that leave the function's expressions (and the
+// values they read) untouched. Together with CFGAnalyses it keeps the domain
+// and every dataflow result below cached across such passes.
+struct ExpressionAnalyses {
+    static AnalysisSetKey *ID() { return &SetKey; }
+private:
+    static AnalysisSetKey SetKey;
+};
+AnalysisSetKey ExpressionAnalyses::SetKey;
+
+// Shared invalidation rule: keep a result if it was preserved explicitly or if
+// neither the CFG nor the function's expressions were touched.
+static bool keepsExpressionResult(PreservedAnalyses::PreservedAnalysisChecker PAC) {
+    return PAC.preserved() || (PAC.preservedSet<ExpressionAnalyses>() && PAC.preservedSet<CFGAnalyses>());
+}
+
+struct ExpressionChanges;
+
+// Off: expressions are told apart by their operand values, so x*c and x2*c
+// differ even when x and x2 are both a+b, and each level of such a chain takes
+// another lcm run. On: operands are replaced by the leaders of their
+// congruence classes first, and the whole chain is one set of expressions.
+static cl::opt<bool> ValueNumbering(
+    "lcm-value-numbering", cl::init(false),
+    cl::desc("Build the expression domain over value numbers (congruence classes) instead of operand identity"));
+
+// Loads join the domain keyed by type and address. Their operand is killed
+// like any other, and every store or call MemorySSA lists as a def kills the
+// loads alias analysis says it may write.
+static cl::opt<bool> LoadExpressions(
+    "lcm-loads", cl::init(false),
+    cl::desc("Add simple loads to the expression domain, killed by the stores and calls that may clobber them"));
+
+// The expressions of a function, numbered once in instruction order (so the
+// numbering is deterministic) with a hashed index, plus the block numbering
+// all dataflow matrices are indexed by. Every analysis below and
+// LazyCodeMotion reference this cached result instead of building their own.
+struct ExpressionDomain {
+    BlockNumbering cfg;                     // Row numbering shared by every matrix
+    std::vector<Expression> exprVec;        // Index -> expression
+    DenseMap<Expression, unsigned> exprMap; // Expression -> index
     unsigned numExpr = 0;
 
-    // GEN/KILL sets specific to each analysis
-    // Note: For Postponable, KILL depends on UsedExpressions result,
-    // so it won't be stored here directly.
-    DenseMap<BasicBlock*, BitVector> genSets;
-    DenseMap<BasicBlock*, BitVector> killSets; // Used by Avail, Anticip, Used
+    // Inverted indices used to build local GEN/KILL sets in one pass per block
+    DenseMap<const Instruction*, unsigned> instToExpr;       // Computing instruction -> index
+    DenseMap<const Value*, SmallVector<unsigned, 2>> opUsers; // Operand -> indices of expressions using it
+    DenseMap<const Instruction*, SmallVector<unsigned, 2>> clobbers; // Memory def -> load expressions it may write
+    std::vector<unsigned> trapping;         // Expressions that may trap (division, remainder, loads)
+
+    // Index of E in the domain, or -1 if E is not part of it
+    int lookup(const Expression &E) const {
+        auto it = exprMap.find(E);
+        return it == exprMap.end() ? -1 : (int)it->second;
+    }
+
+    // Index of the expression I computes, or -1 if I computes none
+    int exprOf(const Instruction *I) const {
+        auto it = instToExpr.find(I);
+        return it == instToExpr.end() ? -1 : (int)it->second;
+    }
+
+    // Indices of the expressions that have V as an operand
+    ArrayRef<unsigned> usersOf(const Value *V) const {
+        auto it = opUsers.find(V);
+        if (it == opUsers.end()) return {};
+        return it->second;
+    }
+
+    // Indices of the load expressions I may clobber (-lcm-loads)
+    ArrayRef<unsigned> clobberedBy(const Instruction *I) const {
+        auto it = clobbers.find(I);
+        if (it == clobbers.end()) return {};
+        return it->second;
+    }
+
+    // Indices of the expressions that may trap, if execution may stop at I (a
+    // call that may not return or may unwind): they are not anticipated above it
+    ArrayRef<unsigned> stoppedBy(const Instruction *I) const {
+        if (trapping.empty() || isGuaranteedToTransferExecutionToSuccessor(I)) return {};
+        return trapping;
+    }
+
+    // Appends the expressions whose GEN/KILL rows in I's block depend on I: the
+    // one it computes, those it kills and those whose first computation it uses
+    void touchedBy(const Instruction &I, SmallVectorImpl<unsigned> &exprs) const {
+        if (int idx = exprOf(&I); idx >= 0) exprs.push_back(idx);
+        append_range(exprs, usersOf(&I));
+        append_range(exprs, clobberedBy(&I));
+        append_range(exprs, stoppedBy(&I));
+        for (const Value *operand : I.operands()) {
+            if (int idx = exprOf(dyn_cast<Instruction>(operand)); idx >= 0) exprs.push_back(idx);
+        }
+    }
+
+    bool invalidate(Function &F, const PreservedAnalyses &PA, FunctionAnalysisManager::Invalidator &Inv);
+
+    // Renumbers F after the changes in C, exactly as build() would, and
+    // describes how the new numbering relates to the old one. The numbering
+    // itself is not incremental: it is rebuilt from the whole function, since
+    // one inserted temporary can shift the indices of every expression after
+    // it. What the delta saves is the dataflow, which is then re-solved only
+    // for the affected expressions from the dirty blocks. The rebuild is the
+    // plain one, without value numbering or loads (see updateAnalyses).
+    DomainDelta update(Function &F, const ExpressionChanges &C);
+
+    // With DT, the keys are over value numbers (-lcm-value-numbering). With
+    // MSSA and AA, simple loads are expressions too (-lcm-loads).
+    static ExpressionDomain build(Function &F, const DominatorTree *DT = nullptr,
+                                  MemorySSA *MSSA = nullptr, AAResults *AA = nullptr) {
+        TimeRegion T(stageTimer(StageDomain));
+        ExpressionDomain D;
+        D.cfg.build(F);
+        DenseMap<const Instruction*, Expression> keys;
+        if (DT) keys = numberValues(F, *DT);
+        for (auto &BB : F) { for (auto &I : BB) { if (Expression::isCandidate(I) || (MSSA && Expression::isLoad(I))) {
+            auto key = keys.find(&I); // Unreachable blocks are not numbered
+            Expression expr = key != keys.end() ? key->second : Expression(&I); if (!expr.isValid()) continue;
+            auto result = D.exprMap.insert({expr, (unsigned)D.exprVec.size()}); // Use insert to check uniqueness
+            unsigned idx = result.first->second;
+            D.instToExpr[&I] = idx;
+            if (result.second) { // First occurrence fixes the index
+                D.exprVec.push_back(expr);
+                if (!isSafeToSpeculativelyExecute(&I)) D.trapping.push_back(idx);
+                for (unsigned k = 0; k < expr.ops.size(); ++k) {
+                    if (!is_contained(ArrayRef<Value*>(expr.ops).take_front(k), expr.ops[k])) D.opUsers[expr.ops[k]].push_back(idx);
+                }
+            }
+        }}}
+        D.numExpr = D.exprVec.size();
+        if (MSSA) D.findClobbers(F, *MSSA, *AA);
+        NumExpressions += D.numExpr;
+        return D;
+    }
+
+    // Every MemoryDef (store, call, fence, ...) against the address of every
+    // load expression. The location has no AA tags: the occurrences of one
+    // expression may carry different TBAA, so none of them may decide.
+    void findClobbers(Function &F, MemorySSA &MSSA, AAResults &AA) {
+        SmallVector<std::pair<unsigned, MemoryLocation>, 8> loads;
+        for (unsigned e = 0; e < numExpr; ++e) {
+            if (auto *LI = dyn_cast<LoadInst>(exprVec[e].definingInst))
+                loads.push_back({e, MemoryLocation::get(LI).getWithoutAATags()});
+        }
+        if (loads.empty()) return;
+        BatchAAResults BAA(AA); // The IR does not change while the domain is built
+        for (BasicBlock &BB : F) {
+            const MemorySSA::DefsList *Defs = MSSA.getBlockDefs(&BB);
+            if (!Defs) continue;
+            for (const MemoryAccess &MA : *Defs) {
+                auto *Def = dyn_cast<MemoryDef>(&MA); // Skips the block's MemoryPhi
+                if (!Def) continue;
+                Instruction *I = Def->getMemoryInst();
+                for (auto &[e, Loc] : loads) {
+                    if (isModSet(BAA.getModRefInfo(I, Loc))) clobbers[I].push_back(e);
+                }
+            }
+        }
+    }
+
+    // Congruence classes in the style of GVN: walking F in RPO, each
+    // computation's key is built with every operand replaced by the leader of
+    // its class (the first computation with that key) where the leader
+    // dominates the computation. The operands of a key then dominate every
+    // occurrence, as plain SSA operands do, which the placements rely on.
+    // Phis and other non-expressions lead their own classes.
+    static DenseMap<const Instruction*, Expression> numberValues(Function &F, const DominatorTree &DT) {
+        DenseMap<const Instruction*, Expression> keys;
+        DenseMap<Expression, Instruction*> leaders;
+        DenseMap<const Value*, Instruction*> leaderOf; // Members other than the leader only
+        ReversePostOrderTraversal<Function*> RPOT(&F);
+        for (BasicBlock *BB : RPOT) {
+            for (Instruction &I : *BB) {
+                if (!Expression::isCandidate(I)) continue;
+                Expression key(&I);
+                for (Value *&V : key.ops) {
+                    auto it = leaderOf.find(V);
+                    if (it != leaderOf.end() && DT.dominates(it->second, &I)) V = it->second;
+                }
+                auto [pos, inserted] = leaders.try_emplace(key, &I);
+                if (!inserted) leaderOf[&I] = pos->second;
+                keys[&I] = std::move(key);
+            }
+        }
+        return keys;
+    }
+};
+
+// What a transformation did to a function, recorded while it rewrites the IR
+// so the cached domain and dataflow results can be updated in place instead of
+// being recomputed (LazyCodeMotion::updateAnalyses). Blocks may be added by
+// splitting edges but never removed.
+struct ExpressionChanges {
+    SmallPtrSet<const BasicBlock*, 16> blocks;     // Instructions inserted, erased or rewritten here
+    SmallPtrSet<const BasicBlock*, 4> newBlocks;   // Created by splitting an edge
+    SmallPtrSet<const BasicBlock*, 8> rewired;     // Gained or lost an edge
+    SmallPtrSet<const Instruction*, 16> erased;    // Only compared against, never dereferenced
+    SmallVector<unsigned, 32> oldExprs;            // Old-domain expressions the change touched
+
+    bool empty() const { return blocks.empty() && newBlocks.empty(); }
+    void clear() { blocks.clear(); newBlocks.clear(); rewired.clear(); erased.clear(); oldExprs.clear(); }
+
+    void inserted(const Instruction *I) { blocks.insert(I->getParent()); }
+    // Before I's operands are rewritten (D is the domain the results were computed over)
+    void changing(const Instruction *I, const ExpressionDomain &D) { blocks.insert(I->getParent()); D.touchedBy(*I, oldExprs); }
+    // Before I is erased
+    void erasing(const Instruction *I, const ExpressionDomain &D) { changing(I, D); erased.insert(I); }
+    void edgeSplit(const BasicBlock *From, const BasicBlock *NewBB, const BasicBlock *To) {
+        newBlocks.insert(NewBB); rewired.insert(From); rewired.insert(To);
+    }
+};
+
+DomainDelta ExpressionDomain::update(Function &F, const ExpressionChanges &C) {
+    ExpressionDomain old = std::move(*this);
+    *this = build(F);
+    DomainDelta Delta;
+
+    const unsigned numBlocks = cfg.getNumBlocks();
+    Delta.oldBlock.resize(numBlocks);
+    Delta.dirty.resize(numBlocks);
+    for (unsigned b = 0; b < numBlocks; ++b) {
+        const BasicBlock *BB = cfg.getBlock(b);
+        Delta.oldBlock[b] = C.newBlocks.count(BB) ? -1 : old.cfg.findBlock(BB);
+        if (Delta.oldBlock[b] < 0 || C.blocks.count(BB) || C.rewired.count(BB)) Delta.dirty.set(b);
+    }
+
+    // Expressions are matched by key. The keys of the old domain may hold erased
+    // values, which are only hashed and compared here.
+    Delta.newCol.assign(old.numExpr, -1);
+    Delta.fresh.resize(numExpr); Delta.affected.resize(numExpr);
+    Delta.sameColumns = old.numExpr == numExpr;
+    SmallPtrSet<const Instruction*, 16> oldFirsts; // First computations that were displaced but survive
+    for (unsigned c = 0; c < numExpr; ++c) {
+        int o = old.lookup(exprVec[c]);
+        Delta.sameColumns &= o == (int)c;
+        if (o < 0) { Delta.fresh.set(c); Delta.affected.set(c); continue; }
+        Delta.newCol[o] = c;
+        const Instruction *oldFirst = old.exprVec[o].definingInst;
+        if (oldFirst != exprVec[c].definingInst) {
+            Delta.affected.set(c);
+            if (!C.erased.count(oldFirst)) oldFirsts.insert(oldFirst);
+        }
+    }
+    for (unsigned o : C.oldExprs) { if (Delta.newCol[o] >= 0) Delta.affected.set(Delta.newCol[o]); }
+    SmallVector<unsigned, 32> touched;
+    for (const BasicBlock *BB : C.blocks) { for (const Instruction &I : *BB) touchedBy(I, touched); }
+    for (unsigned c : touched) Delta.affected.set(c);
+
+    // Outside the changed blocks GEN/KILL can only differ for an affected
+    // expression, where its operands are defined and where its first
+    // computation is used (the used-expressions GEN) and, for one that may
+    // trap, wherever execution may stop (the anticipated-expressions KILL)
+    auto dirtyAt = [&](const Value *V) {
+        if (auto *I = dyn_cast<Instruction>(V)) Delta.dirty.set(cfg.blockIndex(I->getParent()));
+    };
+    for (unsigned c : Delta.affected.set_bits()) {
+        const Expression &E = exprVec[c];
+        for (const Value *V : E.ops) dirtyAt(V);
+        for (const User *U : E.definingInst->users()) dirtyAt(U);
+    }
+    for (const Instruction *I : oldFirsts) { for (const User *U : I->users()) dirtyAt(U); }
+    if (llvm::any_of(trapping, [&](unsigned c) { return Delta.affected.test(c); }))
+        for (const BasicBlock &BB : F)
+            if (llvm::any_of(BB, [&](const Instruction &I) { return !stoppedBy(&I).empty(); })) dirtyAt(&BB.front());
+    return Delta;
+}
+
+class ExpressionDomainAnalysis : public AnalysisInfoMixin<ExpressionDomainAnalysis> {
+public:
+    friend AnalysisInfoMixin<ExpressionDomainAnalysis>;
+    static AnalysisKey Key;
+    using Result = ExpressionDomain;
+
+    Result run(Function &F, FunctionAnalysisManager &AM) {
+        MemorySSA *MSSA = LoadExpressions ? &AM.getResult<MemorySSAAnalysis>(F).getMSSA() : nullptr;
+        AAResults *AA = LoadExpressions ? &AM.getResult<AAManager>(F) : nullptr;
+        return ExpressionDomain::build(F, ValueNumbering ? &AM.getResult<DominatorTreeAnalysis>(F) : nullptr, MSSA, AA);
+    }
+};
+AnalysisKey ExpressionDomainAnalysis::Key;
+
+bool ExpressionDomain::invalidate(Function &, const PreservedAnalyses &PA, FunctionAnalysisManager::Invalidator &) {
+    return !keepsExpressionResult(PA.getChecker<ExpressionDomainAnalysis>());
+}
+
+// Cached result of one of the dataflow analyses: only the converged IN/OUT
+// matrices, indexed through the shared domain. The solver, GEN/KILL and the
+// analysis object itself are dropped once the analysis has run.
+class DataflowResult {
+public:
+    DataflowResult(AnalysisKey *ID, const ExpressionDomain &domain) : ID(ID), domain(&domain) {}
+
+    const ExpressionDomain &getDomain() const { return *domain; }
+    const BlockNumbering &getNumbering() const { return domain->cfg; }
+    const BitMatrix &in() const { return In; }
+    const BitMatrix &out() const { return Out; }
+
+    // Moves the matrices out of a solver that has finished running
+    void takeFrom(Dataflow &df) { df.releaseResults(In, Out); }
+
+    bool invalidate(Function &F, const PreservedAnalyses &PA, FunctionAnalysisManager::Invalidator &Inv) {
+        // Rows and columns are numbered by the domain, so the result goes with it
+        if (Inv.invalidate<ExpressionDomainAnalysis>(F, PA)) return true;
+        return !keepsExpressionResult(PA.getChecker(ID));
+    }
+
+private:
+    AnalysisKey *ID; // Key of the analysis that produced this result
+    const ExpressionDomain *domain;
+    BitMatrix In, Out;
+};
 
-    // Dataflow framework instance to store results (IN/OUT sets)
-    Dataflow df;
+
+// Base class for Analysis Passes
+class AnalysisPassBase {
+public:
+    // Shared domain (owned by the analysis manager's ExpressionDomainAnalysis result)
+    const ExpressionDomain *domain = nullptr;
 
     // Default constructor and move semantics
     AnalysisPassBase() = default;
@@ -361,36 +1412,55 @@ public:
     AnalysisPassBase(AnalysisPassBase&&) = default; // Allow moving
     AnalysisPassBase& operator=(AnalysisPassBase&&) = default;
 
-    // Build the domain of expressions for the given function
-    void buildExpressionDomain(Function &F) {
-        exprMap.clear(); exprVec.clear(); numExpr = 0; int idx = 0;
-        for (auto &BB : F) { for (auto &I : BB) { if (auto *BO = dyn_cast<BinaryOperator>(&I)) {
-            Expression expr(&I); if (!expr.isValid()) continue;
-            auto result = exprMap.insert({expr, idx}); // Use insert to check uniqueness
-            if (result.second) { // If inserted successfully (was unique)
-                exprVec.push_back(expr);
-                idx++;
-            }
-        }}}
-        numExpr = exprVec.size();
+    // Abstract method to be implemented by derived analysis passes
+    // Fills the GEN/KILL rows of block BB where possible (may only calculate GEN
+    // if KILL depends on other analyses). The solver's domain must be initialised.
+    virtual void calculateGenKill(BasicBlock &BB, Dataflow &df) = 0;
+
+    // GEN/KILL for every block of F, or only for the given ones
+    void calculateGenKillSets(Function &F, Dataflow &df) { for (auto &BB : F) calculateGenKill(BB, df); }
+    void calculateGenKillSets(Dataflow &df, const BitVector &blocks) {
+        for (unsigned b : blocks.set_bits()) calculateGenKill(*df.getBlock(b), df);
     }
 
-    // Abstract method to be implemented by derived analysis passes
-    // Calculates GEN/KILL where possible (may only calculate GEN if KILL depends on other analyses)
-    virtual void calculateGenKillSets(Function &F) = 0;
+    // Incremental counterpart of solve(): re-solves from the fixpoint in R after
+    // the change described by Delta, visiting only the blocks it can reach. The
+    // solver must be configured as for solve(). False if R holds no fixpoint to
+    // start from, there is nothing to solve or the change reaches too much of it.
+    template <typename SolverT>
+    bool resume(Function &F, const ExpressionDomain &D, const DomainDelta &Delta, const DataflowResult &R, SolverT &df, StringRef name) {
+        domain = &D;
+        if (domain->numExpr == 0 || R.in().rows() == 0) return false;
+        df.initializeDomain(domain->cfg, domain->numExpr);
+        BitVector region;
+        if (!df.seed(Delta, R.in(), R.out(), region)) return false;
+        calculateGenKillSets(df, region);
+        df.resume(F, name);
+        LLVM_DEBUG(dbgs() << name << ": re-solved " << F.getName() << " in " << df.getNumIterations() << " block visits\n");
+        return true;
+    }
+
+    // Does I define a value that kills the expressions using it as an operand?
+    // (isn't void, store or terminator; memory effects are not modelled). A phi
+    // kills at the top of its block, so nothing using it is anticipated above it.
+    static bool definesKillingValue(const Instruction &I) {
+        return !I.getType()->isVoidTy() && !isa<StoreInst>(&I) && !I.isTerminator();
+    }
 
-    // Printing function (shared by all analysis passes)
-    void printDataflowResults(Function &F) {
+    // Printing function (shared by all analysis passes), called while the solver is still alive
+    void printDataflowResults(Function &F, const Dataflow &df) {
         outs() << "\n=================================================\n";
         // Use RTTI to get the actual analysis pass name
         outs() << "Dataflow Results for: UnifiedPass::" << demangle(typeid(*this).name()) << "\n";
         outs() << "Function: " << F.getName() << "\n";
+        outs() << "Converged after " << df.getNumIterations() << " block visits ("
+               << F.size() << " blocks, " << df.getNumSCCs() << " SCCs)\n";
         outs() << "-------------------------------------------------\n";
         // Print the expression domain mapping
         outs() << "Expression Domain (Index: Expression):\n";
-        for(size_t i = 0; i < exprVec.size(); ++i) {
-             if (i < exprVec.size() && exprVec[i].isValid()) {
-                outs() << "  " << i << ": " << exprVec[i].toString() << "\n";
+        for(size_t i = 0; i < domain->exprVec.size(); ++i) {
+             if (i < domain->exprVec.size() && domain->exprVec[i].isValid()) {
+                outs() << "  " << i << ": " << domain->exprVec[i].toString() << "\n";
             } else {
                  outs() << "  " << i << ": <invalid expression in vector index " << i << ">\n";
             }
@@ -399,11 +1469,7 @@ public:
 
         for (auto &BB : F) {
             BasicBlock* B = &BB;
-            // Get state, gen, and kill for the current block
-            auto state_it = df.getStates().find(B);
-            auto gen_it = genSets.find(B);
-            // KILL set might not be stored for Postponable, handle gracefully
-            auto kill_it = killSets.find(B);
+            unsigned b = df.blockIndex(B); // Row of this block in every matrix
 
             outs() << "Basic Block ";
             if (B->hasName()) { outs() << B->getName(); }
@@ -411,25 +1477,15 @@ public:
             outs() << "\n";
 
             // Print Gen set
-            outs() << "  gen\t"
-                   << (gen_it != genSets.end() ? Dataflow::bitVectorExprToString(gen_it->second, exprVec) : "<Not Found>")
-                   << "\n";
-
-            // Print Kill set (if available in killSets map)
-            // For Postponable, KILL = USED_IN, which isn't stored here, so this will show <Not Found> or be empty.
-            // Consider adding USED_IN printout within Postponable's run if needed for clarity.
-            outs() << "  kill\t"
-                   << (kill_it != killSets.end() ? Dataflow::bitVectorExprToString(kill_it->second, exprVec) : "") // Print empty if not found
-                   << "\n";
-
-            // Print In/Out sets (if state was computed)
-            if (state_it == df.getStates().end()) {
-                 outs() << "  State not found!\n";
-            } else {
-                auto& state = state_it->second; // Use iterator result
-                outs() << "  In\t"   << Dataflow::bitVectorExprToString(state.In, exprVec) << "\n";
-                outs() << "  Out\t"  << Dataflow::bitVectorExprToString(state.Out, exprVec) << "\n";
-            }
+            outs() << "  gen\t" << Dataflow::bitVectorExprToString(df.gen(), b, domain->exprVec) << "\n";
+
+            // Print Kill set
+            // For Postponable, KILL = USED_IN, which is read from UsedExpressions and not stored, so this is empty.
+            outs() << "  kill\t" << Dataflow::bitVectorExprToString(df.kill(), b, domain->exprVec) << "\n";
+
+            // Print In/Out sets
+            outs() << "  In\t"   << Dataflow::bitVectorExprToString(df.in(), b, domain->exprVec) << "\n";
+            outs() << "  Out\t"  << Dataflow::bitVectorExprToString(df.out(), b, domain->exprVec) << "\n";
             outs() << "---\n"; // Separator
         }
         outs() << "=================================================\n\n";
@@ -444,85 +1500,87 @@ class AvailableExpressions : public AnalysisPassBase, public AnalysisInfoMixin<A
 public:
     friend AnalysisInfoMixin<AvailableExpressions>;
     static AnalysisKey Key;
-    using Result = AvailableExpressions; // Result type is the analysis itself
+    using Result = DataflowResult; // Only the converged IN/OUT sets are cached
+
+    // Forward, intersection, OUT = (IN - KILL) U GEN
+    using Solver = DataflowSolver<Dataflow::FORWARD, IntersectMeet, GenKillTransfer>;
 
     AvailableExpressions() = default; // Use default constructor
 
     // Implement GEN/KILL calculation for Available Expressions
-    void calculateGenKillSets(Function &F) override {
-      genSets.clear(); killSets.clear();
-      for (auto &BB : F) {
-          BitVector gen_b(numExpr); BitVector kill_b(numExpr);
-          for (auto &I : BB) {
-              // Check if I kills any expressions by redefining an operand
-              Value* definedValue = nullptr;
-              // Simple check: if I is an instruction that defines a value (isn't void, store, term, phi, cmp)
-              // More complex checks might be needed for memory operations.
-              if (!I.getType()->isVoidTy() && !isa<StoreInst>(&I) && !I.isTerminator() && !isa<PHINode>(&I) && !isa<CmpInst>(&I)) {
-                   definedValue = &I;
-              }
-              if (definedValue) {
-                  for (size_t i = 0; i < exprVec.size(); ++i) {
-                       // Ensure exprVec[i] is valid before accessing members
-                       if (i < exprVec.size() && exprVec[i].isValid()) {
-                           if (exprVec[i].v1 == definedValue || exprVec[i].v2 == definedValue) {
-                               kill_b.set(i); // Definition kills expressions using the defined value
-                           }
-                       }
-                   }
-              }
-
-              // Check if I generates an expression
-              if (auto *BO = dyn_cast<BinaryOperator>(&I)) {
-                  Expression currentExpr(&I); if (!currentExpr.isValid()) continue;
-                  auto it = exprMap.find(currentExpr);
-                  if (it != exprMap.end()) {
-                      // Generate the expression
-                      gen_b.set(it->second);
-                      // An instruction generating an expression cannot kill it within the same instruction
-                      kill_b.reset(it->second);
-                  }
-              }
+    void calculateGenKill(BasicBlock &BB, Dataflow &df) override {
+      BitMatrix &gen = df.gen(), &kill = df.kill();
+      unsigned b = df.blockIndex(&BB);
+      for (auto &I : BB) {
+          // Check if I kills any expressions by redefining an operand
+          if (definesKillingValue(I)) {
+              for (unsigned i : domain->usersOf(&I)) kill.set(b, i); // Only expressions using I
+          }
+          // or by writing memory a load expression reads; unlike an operand
+          // this can follow a computation in the block, which it undoes
+          for (unsigned i : domain->clobberedBy(&I)) { kill.set(b, i); gen.reset(b, i); }
+
+          // Check if I generates an expression
+          int idx = domain->exprOf(&I);
+          if (idx >= 0) {
+              // Generate the expression
+              gen.set(b, idx);
+              // An instruction generating an expression cannot kill it within the same instruction
+              kill.reset(b, idx);
           }
-          genSets[&BB] = gen_b; killSets[&BB] = kill_b;
       }
      }
 
-    // Meet operator: Intersection
-    BitVector meetAvail(BitVector bv1, BitVector bv2) { bv1 &= bv2; return bv1; }
-
-    // Transfer function: OUT = (IN - KILL) U GEN
-    BitVector transferAvail(BasicBlock* B, const BitVector& InSet) {
-      BitVector OutSet = InSet;
-      auto kill_it = killSets.find(B);
-      auto gen_it = genSets.find(B);
-      if (kill_it != killSets.end()) { OutSet.reset(kill_it->second); /* OUT = IN - KILL */ }
-      if (gen_it != genSets.end()) { OutSet |= gen_it->second; /* OUT = OUT U GEN */ }
-      return OutSet;
-     }
+    // Boundary and initial value, shared by solve() and update()
+    static void configure(Solver &df) {
+        df.setBoundary(Dataflow::EMPTY) // Nothing available at the very start
+          .setInitial(Dataflow::ALL);   // Converges faster if we assume all available initially
+    }
+
+    // Builds GEN/KILL and solves into df; false if the function has no expressions
+    bool solve(Function &F, const ExpressionDomain &D, Solver &df) {
+        domain = &D; // Shared expression numbering
+        if (domain->numExpr == 0) return false;
+        df.initializeDomain(domain->cfg, domain->numExpr); // Shared block numbering, size GEN/KILL
+        { TimeRegion T(stageTimer(StageAvailGenKill)); calculateGenKillSets(F, df); } // Calculate GEN/KILL for all blocks
+
+        // Configure and run the dataflow analysis
+        configure(df);
+        { TimeRegion T(stageTimer(StageAvailSolve)); df.run(F, "AvailableExpressions"); } // Run the framework
+        return true;
+    }
 
-    // Run method for the new Pass Manager
+    // Run method for the new Pass Manager: solve, then keep only IN/OUT
     Result run(Function &F, FunctionAnalysisManager &AM) {
-        buildExpressionDomain(F); // Build map/vector of expressions
-        if (numExpr > 0) {
-            calculateGenKillSets(F); // Calculate GEN/KILL for all blocks
-
-            // Configure and run the dataflow analysis
-            df.initializeDomain(numExpr);
-            BitVector intersectionIdentity(numExpr, true); // Identity for intersection is 'all true'
-            df.setDirection(Dataflow::FORWARD)
-              .setBoundary(Dataflow::EMPTY) // Nothing available at the very start
-              .setInitial(Dataflow::ALL)    // Converges faster if we assume all available initially
-              .setMeetOp([this](auto... args) { return this->meetAvail(args...); })
-              .setTransferFn([this](auto* b, auto const& inSet) { return this->transferAvail(b, inSet); })
-              .setMeetIdentity(intersectionIdentity);
-            df.run(F, "AvailableExpressions"); // Run the framework
-
-            // *** ADDED: Print results after analysis ***
-            printDataflowResults(F);
+        return compute(F, AM.getResult<ExpressionDomainAnalysis>(F));
+    }
+
+    // Same, over a domain the caller owns (no analysis manager involved)
+    Result compute(Function &F, const ExpressionDomain &D) {
+        Solver df; // Lives only for this run; the result keeps IN/OUT
+        Result R(&Key, D);
+        if (solve(F, D, df)) {
+            LCM_LOG(3, printDataflowResults(F, df));
+            R.takeFrom(df);
         }
-        // Return 'this' analysis object by moving it
-        return std::move(*this);
+        return R;
+    }
+
+    // Brings a cached result up to date after the change described by Delta
+    // (D already renumbered) by re-solving from its fixpoint. False if that is
+    // not worth it, leaving R stale for the caller to drop.
+    bool update(Function &F, const ExpressionDomain &D, const DomainDelta &Delta, Result &R) {
+        Solver df;
+        configure(df);
+        if (!resume(F, D, Delta, R, df, "AvailableExpressions")) return false;
+        R.takeFrom(df);
+        return true;
+    }
+
+    // Full GEN/KILL/IN/OUT tables, recomputed on request (print-* pipelines)
+    void print(Function &F, FunctionAnalysisManager &AM) {
+        Solver df;
+        if (solve(F, AM.getResult<ExpressionDomainAnalysis>(F), df)) printDataflowResults(F, df);
     }
 };
 AnalysisKey AvailableExpressions::Key;
@@ -535,85 +1593,91 @@ class AnticipatedExpressions : public AnalysisPassBase, public AnalysisInfoMixin
 public:
     friend AnalysisInfoMixin<AnticipatedExpressions>;
     static AnalysisKey Key;
-    using Result = AnticipatedExpressions;
+    using Result = DataflowResult;
+
+    // Backward, intersection, IN = (OUT - KILL) U GEN
+    using Solver = DataflowSolver<Dataflow::BACKWARD, IntersectMeet, GenKillTransfer>;
 
     AnticipatedExpressions() = default;
 
     // Implement GEN/KILL for Anticipated Expressions (Backward)
-    void calculateGenKillSets(Function &F) override {
-      genSets.clear(); killSets.clear();
-      for (auto &BB : F) {
-          BitVector gen_b(numExpr); BitVector kill_b(numExpr);
-          // Iterate backwards through instructions in the block
-          for (auto it = BB.rbegin(), et = BB.rend(); it != et; ++it) {
-              Instruction &I = *it;
-
-              // Check if I kills an expression (defines an operand)
-              Value* definedValue = nullptr;
-              if (!I.getType()->isVoidTy() && !isa<StoreInst>(&I) && !I.isTerminator() && !isa<PHINode>(&I) && !isa<CmpInst>(&I)) {
-                  definedValue = &I;
-              }
-              if (definedValue) {
-                  for(size_t i = 0; i < exprVec.size(); ++i) {
-                       if (i < exprVec.size() && exprVec[i].isValid()) {
-                          if (exprVec[i].v1 == definedValue || exprVec[i].v2 == definedValue) {
-                              kill_b.set(i);  // Mark expression as killed
-                              gen_b.reset(i); // If killed, it cannot be generated later (backward)
-                          }
-                       }
-                  }
-              }
-
-               // Check if I generates an expression (computes it)
-               if (auto *BO = dyn_cast<BinaryOperator>(&I)) {
-                  Expression currentExpr(&I); if (!currentExpr.isValid()) continue;
-                  auto expr_it = exprMap.find(currentExpr);
-                  if (expr_it != exprMap.end()) {
-                      int idx = expr_it->second;
-                      // Generate only if not killed earlier in the backward pass through the block
-                      if (!kill_b.test(idx)) {
-                          gen_b.set(idx);
-                      }
-                  }
+    void calculateGenKill(BasicBlock &BB, Dataflow &df) override {
+      BitMatrix &gen = df.gen(), &kill = df.kill();
+      unsigned b = df.blockIndex(&BB);
+      // Iterate backwards through instructions in the block
+      for (auto it = BB.rbegin(), et = BB.rend(); it != et; ++it) {
+          Instruction &I = *it;
+
+          // Check if I kills an expression (defines an operand)
+          if (definesKillingValue(I)) {
+              for (unsigned i : domain->usersOf(&I)) {
+                  kill.set(b, i);  // Mark expression as killed
+                  gen.reset(b, i); // If killed, it cannot be generated later (backward)
               }
           }
-          genSets[&BB] = gen_b; killSets[&BB] = kill_b;
+          for (unsigned i : domain->clobberedBy(&I)) { kill.set(b, i); gen.reset(b, i); }
+          // Past a call that may not return, one that may trap is not down-safe
+          for (unsigned i : domain->stoppedBy(&I)) { kill.set(b, i); gen.reset(b, i); }
+
+          // Check if I generates an expression (computes it). A kill seen
+          // before in this backward pass lies after I, so I still computes the
+          // expression before it; an operand is never defined after its use.
+          int idx = domain->exprOf(&I);
+          if (idx >= 0) {
+              gen.set(b, idx);
+          }
       }
      }
 
-    // Meet operator: Intersection
-    BitVector meetAnticip(BitVector bv1, BitVector bv2) { bv1 &= bv2; return bv1; }
-
-    // Transfer function (Backward): IN = (OUT - KILL) U GEN
-    BitVector transferAnticip(BasicBlock* B, const BitVector& OutSet) {
-      BitVector InSet = OutSet;
-      auto kill_it = killSets.find(B);
-      auto gen_it = genSets.find(B);
-      if(kill_it != killSets.end()) { InSet.reset(kill_it->second); /* IN = OUT - KILL */ }
-      if(gen_it != genSets.end()) { InSet |= gen_it->second; /* IN = IN U GEN */ }
-      return InSet;
-     }
+    // Boundary and initial value, shared by solve() and update()
+    static void configure(Solver &df) {
+        df.setBoundary(Dataflow::EMPTY) // Nothing anticipated after the last instruction
+          .setInitial(Dataflow::ALL);   // Assume all anticipated initially (converges faster)
+    }
 
-    // Run method for the new Pass Manager
+    // Builds GEN/KILL and solves into df; false if the function has no expressions
+    bool solve(Function &F, const ExpressionDomain &D, Solver &df) {
+        domain = &D;
+        if (domain->numExpr == 0) return false;
+        df.initializeDomain(domain->cfg, domain->numExpr);
+        { TimeRegion T(stageTimer(StageAnticGenKill)); calculateGenKillSets(F, df); }
+
+        configure(df);
+        { TimeRegion T(stageTimer(StageAnticSolve)); df.run(F, "AnticipatedExpressions"); }
+        return true;
+    }
+
+    // Run method for the new Pass Manager: solve, then keep only IN/OUT
     Result run(Function &F, FunctionAnalysisManager &AM) {
-        buildExpressionDomain(F);
-        if (numExpr > 0) {
-            calculateGenKillSets(F);
-
-            df.initializeDomain(numExpr);
-            BitVector intersectionIdentity(numExpr, true); // Identity for intersection
-            df.setDirection(Dataflow::BACKWARD)
-              .setBoundary(Dataflow::EMPTY) // Nothing anticipated after the last instruction
-              .setInitial(Dataflow::ALL)    // Assume all anticipated initially (converges faster)
-              .setMeetOp([this](auto... args) { return this->meetAnticip(args...); })
-              .setTransferFn([this](auto* b, auto const& outSet) { return this->transferAnticip(b, outSet); })
-              .setMeetIdentity(intersectionIdentity);
-            df.run(F, "AnticipatedExpressions");
-
-            // *** ADDED: Print results after analysis ***
-            printDataflowResults(F);
+        return compute(F, AM.getResult<ExpressionDomainAnalysis>(F));
+    }
+
+    // Same, over a domain the caller owns (no analysis manager involved)
+    Result compute(Function &F, const ExpressionDomain &D) {
+        Solver df; // Lives only for this run; the result keeps IN/OUT
+        Result R(&Key, D);
+        if (solve(F, D, df)) {
+            LCM_LOG(3, printDataflowResults(F, df));
+            R.takeFrom(df);
         }
-        return std::move(*this);
+        return R;
+    }
+
+    // Brings a cached result up to date after the change described by Delta
+    // (D already renumbered) by re-solving from its fixpoint. False if that is
+    // not worth it, leaving R stale for the caller to drop.
+    bool update(Function &F, const ExpressionDomain &D, const DomainDelta &Delta, Result &R) {
+        Solver df;
+        configure(df);
+        if (!resume(F, D, Delta, R, df, "AnticipatedExpressions")) return false;
+        R.takeFrom(df);
+        return true;
+    }
+
+    // Full GEN/KILL/IN/OUT tables, recomputed on request (print-* pipelines)
+    void print(Function &F, FunctionAnalysisManager &AM) {
+        Solver df;
+        if (solve(F, AM.getResult<ExpressionDomainAnalysis>(F), df)) printDataflowResults(F, df);
     }
 };
 AnalysisKey AnticipatedExpressions::Key;
@@ -626,95 +1690,94 @@ class UsedExpressions : public AnalysisPassBase, public AnalysisInfoMixin<UsedEx
 public:
     friend AnalysisInfoMixin<UsedExpressions>;
     static AnalysisKey Key;
-    using Result = UsedExpressions;
-    // Map from the Instruction* that defines an expr -> index in exprVec
-    std::map<Value*, int> definingInstToExprIndex;
+    using Result = DataflowResult;
+
+    // Backward, union, IN = (OUT - KILL) U GEN
+    using Solver = DataflowSolver<Dataflow::BACKWARD, UnionMeet, GenKillTransfer>;
 
     UsedExpressions() = default;
 
     // Implement GEN/KILL for Used Expressions (Backward)
-    void calculateGenKillSets(Function &F) override {
-        genSets.clear(); killSets.clear();
-        // Precompute map from defining instruction to expression index
-        this->definingInstToExprIndex.clear();
-        for(size_t i = 0; i < exprVec.size(); ++i) {
-            if (exprVec[i].isValid() && exprVec[i].definingInst) {
-                this->definingInstToExprIndex[exprVec[i].definingInst] = i;
+    void calculateGenKill(BasicBlock &BB, Dataflow &df) override {
+        BitMatrix &gen = df.gen(), &kill = df.kill();
+        unsigned b = df.blockIndex(&BB);
+        // Iterate backwards
+        for (auto it = BB.rbegin(), et = BB.rend(); it != et; ++it) {
+            Instruction &I = *it;
+
+            // KILL: If I computes expression E, then E is killed (defined here)
+            int idx = domain->exprOf(&I);
+            if (idx >= 0) {
+                kill.set(b, idx); // Definition kills the expression
+                gen.reset(b, idx); // Cannot be generated if defined here first (backward)
             }
-        }
-
-        for (auto &BB : F) {
-            BitVector gen_b(numExpr); BitVector kill_b(numExpr);
-            // Iterate backwards
-            for (auto it = BB.rbegin(), et = BB.rend(); it != et; ++it) {
-                Instruction &I = *it;
-
-                // KILL: If I computes expression E, then E is killed (defined here)
-                if (auto *BO = dyn_cast<BinaryOperator>(&I)) {
-                    Expression currentExpr(&I);
-                    if (currentExpr.isValid()) {
-                        auto expr_it = exprMap.find(currentExpr);
-                        if (expr_it != exprMap.end()) {
-                            int idx = expr_it->second;
-                            kill_b.set(idx); // Definition kills the expression
-                            gen_b.reset(idx); // Cannot be generated if defined here first (backward)
-                        }
-                    }
-                }
 
-                // GEN: If I uses the result of expression E, then E is generated (used here)
-                for (unsigned opIdx = 0; opIdx < I.getNumOperands(); ++opIdx) {
-                    Value *operand = I.getOperand(opIdx);
-                    // Check if this operand is an instruction that defines an expression we track
-                    auto definingInstIt = this->definingInstToExprIndex.find(operand);
-                    if (definingInstIt != this->definingInstToExprIndex.end()) {
-                        int exprIdx = definingInstIt->second;
-                        // Generate (mark as used) only if not killed earlier (backward) in this block
-                        if (!kill_b.test(exprIdx)) {
-                            gen_b.set(exprIdx);
-                        }
-                    }
+            // GEN: If I uses the result of expression E, then E is generated (used here)
+            for (Value *operand : I.operands()) {
+                // Check if this operand is the instruction that defines an expression we track
+                auto *OpInst = dyn_cast<Instruction>(operand);
+                if (!OpInst) continue;
+                int exprIdx = domain->exprOf(OpInst);
+                if (exprIdx < 0 || domain->exprVec[exprIdx].definingInst != OpInst) continue;
+                // Generate (mark as used) only if not killed earlier (backward) in this block
+                if (!kill.test(b, exprIdx)) {
+                    gen.set(b, exprIdx);
                 }
             }
-            genSets[&BB] = gen_b; killSets[&BB] = kill_b;
         }
      }
 
 
-    // Meet operator: Union
-    BitVector meetUsed(BitVector bv1, BitVector bv2) { bv1 |= bv2; return bv1; }
+    // Boundary and initial value, shared by solve() and update()
+    static void configure(Solver &df) {
+        df.setBoundary(Dataflow::EMPTY) // Nothing used after the last instruction
+          .setInitial(Dataflow::EMPTY); // Assume nothing used initially
+    }
 
-    // Transfer function (Backward): IN = (OUT - KILL) U GEN
-    BitVector transferUsed(BasicBlock* B, const BitVector& OutSet) {
-      BitVector InSet = OutSet;
-      auto kill_it = killSets.find(B);
-      auto gen_it = genSets.find(B);
-      if(kill_it != killSets.end()) { InSet.reset(kill_it->second); /* IN = OUT - KILL */ }
-      if(gen_it != genSets.end()) { InSet |= gen_it->second; /* IN = IN U GEN */ }
-      return InSet;
-     }
+    // Builds GEN/KILL and solves into df; false if the function has no expressions
+    bool solve(Function &F, const ExpressionDomain &D, Solver &df) {
+        domain = &D;
+        if (domain->numExpr == 0) return false;
+        df.initializeDomain(domain->cfg, domain->numExpr);
+        { TimeRegion T(stageTimer(StageUsedGenKill)); calculateGenKillSets(F, df); }
+
+        configure(df);
+        { TimeRegion T(stageTimer(StageUsedSolve)); df.run(F, "UsedExpressions"); }
+        return true;
+    }
 
-   // Run method for the new Pass Manager
-   Result run(Function &F, FunctionAnalysisManager &AM) {
-        buildExpressionDomain(F);
-        if (numExpr > 0) {
-            calculateGenKillSets(F);
-
-            df.initializeDomain(numExpr);
-            BitVector unionIdentity(numExpr, false); // Identity for union is 'all false'
-            df.setDirection(Dataflow::BACKWARD)
-              .setBoundary(Dataflow::EMPTY) // Nothing used after the last instruction
-              .setInitial(Dataflow::EMPTY)  // Assume nothing used initially
-              .setMeetOp([this](auto... args) { return this->meetUsed(args...); })
-              .setTransferFn([this](auto* b, auto const& outSet) { return this->transferUsed(b, outSet); })
-              .setMeetIdentity(unionIdentity);
-            df.run(F, "UsedExpressions");
-
-            // *** ADDED: Print results after analysis ***
-            printDataflowResults(F);
+    // Run method for the new Pass Manager: solve, then keep only IN/OUT
+    Result run(Function &F, FunctionAnalysisManager &AM) {
+        return compute(F, AM.getResult<ExpressionDomainAnalysis>(F));
+    }
+
+    // Same, over a domain the caller owns (no analysis manager involved)
+    Result compute(Function &F, const ExpressionDomain &D) {
+        Solver df; // Lives only for this run; the result keeps IN/OUT
+        Result R(&Key, D);
+        if (solve(F, D, df)) {
+            LCM_LOG(3, printDataflowResults(F, df));
+            R.takeFrom(df);
         }
-        return std::move(*this);
-   }
+        return R;
+    }
+
+    // Brings a cached result up to date after the change described by Delta
+    // (D already renumbered) by re-solving from its fixpoint. False if that is
+    // not worth it, leaving R stale for the caller to drop.
+    bool update(Function &F, const ExpressionDomain &D, const DomainDelta &Delta, Result &R) {
+        Solver df;
+        configure(df);
+        if (!resume(F, D, Delta, R, df, "UsedExpressions")) return false;
+        R.takeFrom(df);
+        return true;
+    }
+
+    // Full GEN/KILL/IN/OUT tables, recomputed on request (print-* pipelines)
+    void print(Function &F, FunctionAnalysisManager &AM) {
+        Solver df;
+        if (solve(F, AM.getResult<ExpressionDomainAnalysis>(F), df)) printDataflowResults(F, df);
+    }
 };
 AnalysisKey UsedExpressions::Key;
 
@@ -725,99 +1788,127 @@ class PostponableExpressions : public AnalysisPassBase, public AnalysisInfoMixin
 public:
     friend AnalysisInfoMixin<PostponableExpressions>;
     static AnalysisKey Key;
-    using Result = PostponableExpressions;
+    using Result = DataflowResult;
+
+    // Transfer (Backward): IN = (OUT - KILL) U GEN, where KILL = USED_IN[B]
+    // taken straight from the UsedExpressions result instead of a stored set.
+    // Both analyses share the domain's block numbering, so row b is the same block in each.
+    struct PostponTransfer {
+        const BitMatrix *usedIn = nullptr;
+        mutable SmallVector<BitMatrix::Word, 8> usedScratch; // Decoded USED_IN row when sparse
+
+        void operator()(const Dataflow &df, unsigned b, const BitMatrix::Word *OutSet, BitMatrix::Word *InSet) const {
+            usedScratch.resize(usedIn->wordsPerRow());
+            BitMatrix::transferWords(InSet, OutSet, usedIn->readRow(b, usedScratch.data()), df.genRow(b), df.gen().wordsPerRow());
+        }
+    };
+
+    // Backward, union, KILL supplied by UsedExpressions
+    using Solver = DataflowSolver<Dataflow::BACKWARD, UnionMeet, PostponTransfer>;
 
     PostponableExpressions() = default;
 
     // Calculate GEN sets for Postponable expressions. KILL depends on UsedExpressions.
-    void calculateGenKillSets(Function &F) override {
-        genSets.clear();
-        killSets.clear(); // Kill sets are not pre-calculated here, determined by Used_IN.
-
-        for (auto &BB : F) {
-            BitVector gen_b(numExpr);
-            for (auto &I : BB) {
-                // GEN = expressions computed in this block
-                if (auto *BO = dyn_cast<BinaryOperator>(&I)) {
-                    Expression currentExpr(&I);
-                    if (!currentExpr.isValid()) continue;
-                    auto it = exprMap.find(currentExpr);
-                    if (it != exprMap.end()) {
-                        gen_b.set(it->second); // Generate expression computed here
-                    }
-                }
-            }
-            genSets[&BB] = gen_b;
-            // killSets[&BB] is intentionally left empty or not set
+    void calculateGenKill(BasicBlock &BB, Dataflow &df) override {
+        BitMatrix &gen = df.gen(); // KILL rows stay empty, determined by Used_IN.
+        unsigned b = df.blockIndex(&BB);
+        for (auto &I : BB) {
+            // GEN = expressions computed in this block
+            int idx = domain->exprOf(&I);
+            if (idx >= 0) gen.set(b, idx); // Generate expression computed here
         }
     }
 
-    // Meet operator: Union
-    BitVector meetPostpon(BitVector bv1, BitVector bv2) {
-        bv1 |= bv2;
-        return bv1;
-    }
-
-    // Transfer function depends on UsedExpressions result (passed via lambda capture)
-    // IN = (OUT - KILL) U GEN, where KILL = USED_IN[B]
-    BitVector transferPostpon(BasicBlock* B, const BitVector& OutSet, const UsedExpressions::Result& usedResult) {
-        BitVector InSet = OutSet;
-
-        // KILL = USED_IN[B] from the UsedExpressions result
-        const BitVector& killSet = usedResult.df.getState(B).In; // Get USED_IN for B
+    // Builds GEN and solves into df; false if the function has no expressions
+    // usedResult must have been computed over the same domain, so indices line up
+    bool solve(Function &F, const ExpressionDomain &D, const DataflowResult &usedResult, Solver &df) {
+        domain = &D;
+        if (domain->numExpr == 0) return false;
 
-        // GEN = computed in B (pre-calculated in genSets)
-        const BitVector& genSet = this->genSets.count(B) ? this->genSets.lookup(B) : BitVector(this->numExpr); // Default empty
+        // Calculate GEN sets (KILL is handled in transfer function)
+        df.initializeDomain(domain->cfg, domain->numExpr);
+        { TimeRegion T(stageTimer(StagePostponGenKill)); calculateGenKillSets(F, df); }
 
-        // Apply transfer: IN = (OutSet & ~KILL) | GEN
-        BitVector notKill = killSet;
-        notKill.flip();    // Calculate ~KILL
-        InSet &= notKill;  // InSet = OutSet & ~KILL
-        InSet |= genSet;   // InSet = InSet | GEN
+        df.setBoundary(Dataflow::EMPTY) // Nothing postponable after the exit
+          .setInitial(Dataflow::EMPTY); // Assume nothing postponable initially
+        // UsedExpressions result supplies KILL to the transfer policy
+        df.setTransferFn(PostponTransfer{&usedResult.in(), {}});
 
-        return InSet;
+        { TimeRegion T(stageTimer(StagePostponSolve)); df.run(F, "PostponableExpressions"); }
+        return true;
     }
 
-    // Run method for the new Pass Manager
+    // Run method for the new Pass Manager: solve, then keep only IN/OUT
     Result run(Function &F, FunctionAnalysisManager &AM) {
-        // Get the results of the prerequisite UsedExpressions analysis
-        auto &usedResult = AM.getResult<UsedExpressions>(F);
-
-        // Copy domain info from UsedExpressions (or rebuild if necessary)
-        // Need exprMap and exprVec to be populated.
-        buildExpressionDomain(F); // Ensure domain is built for this instance
-
-        if (numExpr > 0) {
-            // Calculate GEN sets (KILL is handled in transfer function)
-            calculateGenKillSets(F);
-
-            df.initializeDomain(numExpr);
-            BitVector unionIdentity(numExpr, false); // Identity for union
-
-            df.setDirection(Dataflow::BACKWARD)
-              .setBoundary(Dataflow::EMPTY) // Nothing postponable after the exit
-              .setInitial(Dataflow::EMPTY)  // Assume nothing postponable initially
-              .setMeetOp([this](auto... args) { return this->meetPostpon(args...); })
-              // Pass UsedExpressions result to the transfer function via lambda capture
-              .setTransferFn([&usedResult, this](auto* b, auto const& outSet) {
-                  return this->transferPostpon(b, outSet, usedResult);
-               })
-              .setMeetIdentity(unionIdentity);
-
-            df.run(F, "PostponableExpressions");
-
-            // Print the results using the base class method
-            printDataflowResults(F);
+        return compute(F, AM.getResult<ExpressionDomainAnalysis>(F), AM.getResult<UsedExpressions>(F));
+    }
+
+    // Same, over a domain and UsedExpressions result the caller owns
+    Result compute(Function &F, const ExpressionDomain &D, const DataflowResult &Used) {
+        Solver df; // Lives only for this run; the result keeps IN/OUT
+        Result R(&Key, D);
+        if (solve(F, D, Used, df)) {
+            LCM_LOG(3, printDataflowResults(F, df));
+            R.takeFrom(df);
         }
-        return std::move(*this);
+        return R;
+    }
+
+    // Full GEN/KILL/IN/OUT tables, recomputed on request (print-* pipelines)
+    void print(Function &F, FunctionAnalysisManager &AM) {
+        Solver df;
+        if (solve(F, AM.getResult<ExpressionDomainAnalysis>(F), AM.getResult<UsedExpressions>(F), df)) printDataflowResults(F, df);
     }
 };
 AnalysisKey PostponableExpressions::Key;
 
 
+//-----------------------------------------------------------------------------
+// Printer pass behind print-avail / print-anticip / print-used / print-postpon.
+// The cached results only hold IN/OUT, so the tables are recomputed here.
+//-----------------------------------------------------------------------------
+template <typename AnalysisT>
+class DataflowPrinterPass : public PassInfoMixin<DataflowPrinterPass<AnalysisT>> {
+public:
+    PreservedAnalyses run(Function &F, FunctionAnalysisManager &AM) {
+        AnalysisT().print(F, AM);
+        return PreservedAnalyses::all();
+    }
+    static bool isRequired() { return true; }
+};
+
+
 //-----------------------------------------------------------------------------
 // 5) Lazy Code Motion Pass (New PM Structure)
 //-----------------------------------------------------------------------------
+static cl::opt<unsigned> LatestVisitBudget(
+    "lcm-latest-budget", cl::init(0), cl::Hidden,
+    cl::desc("Maximum block visits when solving LATER (0 = run to the fixpoint)"));
+
+static cl::opt<unsigned> ConcurrentAnalysesMinBlocks(
+    "lcm-concurrent-analyses", cl::init(0),
+    cl::desc("Solve AVAIL and ANTIC concurrently inside lcm for functions with at least this many blocks (0 = never)"));
+
+static cl::opt<unsigned> LCMThreads(
+    "lcm-threads", cl::init(0),
+    cl::desc("Worker threads used by lcm-parallel and -lcm-concurrent-analyses (0 = one per hardware thread)"));
+
+static cl::opt<bool> UpdateAnalyses(
+    "lcm-update-analyses", cl::init(true),
+    cl::desc("Update the cached expression domain and AVAIL/ANTIC/USED results after lcm changes a function instead of recomputing them"));
+
+static cl::opt<bool> EarliestInsertion(
+    "lcm-earliest", cl::init(false),
+    cl::desc("Insert at the earliest points (LCM-E) instead of the latest (LCM-L)"));
+
+static cl::opt<bool> LoopAware(
+    "lcm-loop-aware", cl::init(false),
+    cl::desc("Before placement, hoist loop-invariant expressions that cannot trap into loop preheaders, innermost loops first"));
+
+static cl::opt<bool> VerifyUpdates(
+    "lcm-verify-updates", cl::init(false), cl::Hidden,
+    cl::desc("Check every incrementally updated lcm analysis against a fresh computation"));
+
 class LazyCodeMotion : public PassInfoMixin<LazyCodeMotion> {
 
 // *** ADDED: Explicit Move Constructor and Assignment Operator ***
@@ -828,44 +1919,36 @@ public:
     // Explicitly define Move Constructor
     LazyCodeMotion(LazyCodeMotion&& Other) noexcept :
         // Move movable members
-        exprMap(std::move(Other.exprMap)),
-        exprVec(std::move(Other.exprVec)),
-        numExpr(Other.numExpr),
+        domain(Other.domain),
         earliestSets(std::move(Other.earliestSets)),
-        latest_inSets(std::move(Other.latest_inSets)),
-        insertSets(std::move(Other.insertSets)),
-        insertedTempsMap(std::move(Other.insertedTempsMap)),
-        // replacementMap(std::move(Other.replacementMap)), // Cannot move ValueMap
-        originalInstructions(std::move(Other.originalInstructions))
-        // Note: replacementMap is default-constructed in the new object.
-        // The moved-from object's map is left as is (but the object is typically discarded post-move).
+        laterInSets(std::move(Other.laterInSets)),
+        deleteSets(std::move(Other.deleteSets)),
+        edgeInserts(std::move(Other.edgeInserts)),
+        latestVisits(Other.latestVisits),
+        changes(std::move(Other.changes)),
+        hoistedPerDepth(std::move(Other.hoistedPerDepth)),
+        solvePool(std::move(Other.solvePool))
     {
         // Ensure moved-from object is in a valid, safe state (optional but good practice)
-        Other.numExpr = 0;
-        // Other.replacementMap.clear(); // If necessary
-        // Other.exprMap.clear(); // etc.
+        Other.domain = nullptr;
     }
 
     // Explicitly define Move Assignment Operator
     LazyCodeMotion& operator=(LazyCodeMotion&& Other) noexcept {
         if (this != &Other) {
             // Move movable members
-            exprMap = std::move(Other.exprMap);
-            exprVec = std::move(Other.exprVec);
-            numExpr = Other.numExpr;
+            domain = Other.domain;
             earliestSets = std::move(Other.earliestSets);
-            latest_inSets = std::move(Other.latest_inSets);
-            insertSets = std::move(Other.insertSets);
-            insertedTempsMap = std::move(Other.insertedTempsMap);
-            originalInstructions = std::move(Other.originalInstructions);
-
-            // Handle non-movable ValueMap: Clear current map, leave source map as is.
-            replacementMap.clear();
+            laterInSets = std::move(Other.laterInSets);
+            deleteSets = std::move(Other.deleteSets);
+            edgeInserts = std::move(Other.edgeInserts);
+            latestVisits = Other.latestVisits;
+            changes = std::move(Other.changes);
+            hoistedPerDepth = std::move(Other.hoistedPerDepth);
+            solvePool = std::move(Other.solvePool);
 
             // Ensure moved-from object is in a valid, safe state (optional)
-            Other.numExpr = 0;
-            // Other.replacementMap.clear(); // If necessary
-            // Other.exprMap.clear(); // etc.
+            Other.domain = nullptr;
         }
         return *this;
     }
@@ -880,107 +1963,100 @@ public:
     // Required by PassInfoMixin, indicates this pass is usable
     static bool isRequired() { return true; }
 
-// --- Member variables and private helper functions ---
-private:
-    // Domain info (copied from analysis results)
-    std::map<Expression, int> exprMap;
-    std::vector<Expression> exprVec;
-    unsigned numExpr = 0;
-
-    // Sets calculated during LCM
-    DenseMap<BasicBlock*, BitVector> earliestSets;
-    DenseMap<BasicBlock*, BitVector> latest_inSets;
-    DenseMap<BasicBlock*, BitVector> insertSets;
-
-    // --- State for transformation phases (REVISED) ---
-    // Map from Block -> Expression -> Inserted Temporary Instruction
-    DenseMap<BasicBlock*, DenseMap<Expression, Instruction*, DenseMapInfo<Expression>>> insertedTempsMap;
-    // Map from Original Instruction -> Best Replacement Value (resolved temporary)
-    ValueMap<Instruction*, Value*> replacementMap; // <-- NON-MOVABLE MEMBER
-    // Keep track of original instructions that might become redundant
-    DenseSet<Instruction*> originalInstructions;
-
-
-    // Helper to find the highest dominating temporary insertion point
-    Instruction* findHighestDominatingTemp(Instruction* userInst, const Expression& expr, DominatorTree& DT) {
-        Instruction* bestTemp = nullptr;
-        BasicBlock* userBlock = userInst->getParent();
-
-        for (auto const& [insertBlock, exprToTempMap] : insertedTempsMap) {
-            if (!exprToTempMap.count(expr)) continue; // Skip blocks where this expr wasn't inserted
-
-            Instruction* currentTemp = exprToTempMap.lookup(expr);
-
-            // Check if currentTemp dominates the user instruction
-            // Need to handle the case where the temp and user are in the same block correctly.
-            // DT.dominates(A, B) is true if A == B.
-            // If they are the same instruction, temp doesn't dominate in the sense we need.
-            if (currentTemp == userInst) continue;
+    // --- The pass in stages (run() composes them; so does LazyCodeMotionModule) ---
+    // Only hoistLoopInvariants and applyPlacement change the IR, and only of
+    // their own function.
+    enum PlacementStatus {
+        Placed,          // Sets computed, ready for applyPlacement
+        NoExpressions,   // Empty domain, nothing to do
+        CFGMismatch,     // Results were computed over a different CFG
+        BudgetExhausted  // LATER stopped by -lcm-latest-budget
+    };
 
-            if (DT.dominates(currentTemp, userInst)) {
-                if (!bestTemp) {
-                    // First dominating temp found
-                    bestTemp = currentTemp;
-                } else {
-                    // Check if currentTemp's block dominates bestTemp's block
-                    // If it does, currentTemp is "higher" in the dominator tree.
-                    // If they are in the same block, prefer the one defined earlier (closer to the start).
-                    // Since we insert at the start, this dominance check is okay.
-                    if (DT.dominates(insertBlock, bestTemp->getParent())) {
-                         bestTemp = currentTemp;
-                    }
-                 }
-            }
-        }
-         return bestTemp;
-    }
-
-     // Helper to resolve replacement chains
-    Value* resolveReplacement(Value* V, ValueMap<Instruction*, Value*>& currentReplacements) {
-        Value* current = V;
-        // Limit iterations to prevent infinite loops in case of cycles (shouldn't happen with dominance)
-        for (int i = 0; i < 100; ++i) { // Increased limit slightly
-            if (auto* Inst = dyn_cast<Instruction>(current)) {
-                 auto it = currentReplacements.find(Inst);
-                 if (it != currentReplacements.end()) {
-                    // Ensure we don't cycle (e.g., A->B and B->A)
-                    if (it->second == V) {
-                        errs() << "Warning: Replacement cycle detected involving: "; Inst->print(errs()); errs() << "\n";
-                        return Inst; // Return original instruction to break cycle
-                    }
-                    current = it->second;
-                 } else {
-                    break; // No further replacement for this instruction
-                 }
-             } else {
-                break; // Not an instruction, cannot be in the replacement map key
-             }
-         }
-        return current;
-     }
+    // -lcm-loop-aware: moves every expression whose operands are defined
+    // outside its loop and that cannot trap into the loop's preheader. Inner
+    // loops go first, so an invariant of a nest ends up in front of the
+    // outermost loop it is invariant in, and dependent invariants follow the
+    // ones they use. Conditionally executed bodies are hoisted from as well,
+    // which placement alone never does. The moves are recorded for
+    // updateAnalyses if D (the cached domain) is given. Returns true if F changed.
+    bool hoistLoopInvariants(Function &F, LoopInfo &LI, const ExpressionDomain *D = nullptr);
+
+    // Prints the hoists of the last hoistLoopInvariants per loop depth
+    void reportHoists(Function &F) const;
+
+    // Steps 1-3: EARLIEST, LATER and the INSERT edges and DELETE blocks from
+    // results computed over D. Reads F but does not modify it.
+    PlacementStatus computePlacementSets(Function &F, const ExpressionDomain &D, const DataflowResult &Avail,
+                                         const DataflowResult &Antic);
+
+    // Solves AVAIL and ANTIC over D on the workers of -lcm-threads, at the same
+    // time when there are two. The two only read F and the shared domain and
+    // block numbering, and each writes its own matrices, so nothing needs
+    // locking until the join. The pool is created on first use and serves
+    // every later function.
+    void solveConcurrently(Function &F, const ExpressionDomain &D, std::optional<DataflowResult> &Avail,
+                           std::optional<DataflowResult> &Antic);
+
+    // Prints the warning for a function computePlacementSets gave up on
+    void reportSkipped(Function &F, PlacementStatus status) const;
+
+    // Phases 1-3: splits the critical edges that receive a computation, inserts
+    // the temporaries, joins them with phis where needed and replaces the
+    // redundant computations. Returns true if F changed.
+    bool applyPlacement(Function &F, DominatorTree &DT);
+
+    // A CFG edge, From -> To
+    using Edge = std::pair<BasicBlock*, BasicBlock*>;
+
+    // Splits the critical edge P->S through one new block, which every copy of
+    // the edge then goes through, keeping DT up to date and recording the new
+    // block in 'changes' if given. Returns the new block, or null when P->S is
+    // not (or no longer) a critical edge of the CFG.
+    static BasicBlock *splitEdge(BasicBlock *P, BasicBlock *S, DominatorTree &DT, ExpressionChanges *changes = nullptr);
+
+    // What run() preserves once F has changed: the dominator tree, plus (with
+    // -lcm-update-analyses) the cached expression domain and AVAIL/ANTIC/USED
+    // results, brought up to date with the changes recorded since the last call
+    PreservedAnalyses updateAnalyses(Function &F, FunctionAnalysisManager &AM);
 
+// --- Member variables and private helper functions ---
+private:
+    // Domain info (the cached ExpressionDomainAnalysis result, shared with the analyses)
+    const ExpressionDomain *domain = nullptr;
+
+    // Sets calculated during LCM, one row per block in the analyses' numbering.
+    // EARLIEST of an edge P->S is ANTIC_IN[S] & earliestSets[P].
+    BitMatrix earliestSets;
+    BitMatrix laterInSets;
+    BitMatrix deleteSets;
+
+    // The edges that receive computations; From is null for the edge into the entry block
+    struct EdgeInsert {
+        BasicBlock *From, *To;
+        SmallVector<unsigned, 4> exprs;
+    };
+    std::vector<EdgeInsert> edgeInserts;
+    // Block visits of the last LATER solve (reported when the budget runs out)
+    unsigned latestVisits = 0;
+    // IR changes not yet applied to the cached analyses
+    ExpressionChanges changes;
+    // Expressions hoisted out of loops of each depth (index 0 unused)
+    SmallVector<unsigned, 4> hoistedPerDepth;
+    // Workers of solveConcurrently, kept for the life of the pass instance
+    std::unique_ptr<ThreadPool> solvePool;
 
-    // Build the domain of expressions for the given function (Internal helper)
-    void buildExpressionDomain(Function &F) {
-        exprMap.clear(); exprVec.clear(); numExpr = 0; int idx = 0;
-        for (auto &BB : F) { for (auto &I : BB) { if (auto *BO = dyn_cast<BinaryOperator>(&I)) {
-            Expression expr(&I); if (!expr.isValid()) continue;
-            auto result = exprMap.insert({expr, idx});
-            if (result.second) { exprVec.push_back(expr); idx++; }
-        }}}
-        numExpr = exprVec.size();
-     }
 
     // Optional: Print helper (Internal helper)
-    void printSetMap(StringRef setName, Function &F, const DenseMap<BasicBlock*, BitVector>& setMap) {
+    void printSetMap(StringRef setName, Function &F, const BlockNumbering &numbering, const BitMatrix& setMap) {
         outs() << "\n--- " << setName << " Sets ---\n"; outs().flush();
         for (auto &BB : F) {
             BasicBlock* B = &BB;
              outs() << "Basic Block ";
             if (B->hasName()) outs() << B->getName(); else outs() << "<bb " << (void*)B << ">";
-            if (setMap.count(B)) {
-                if (!this->exprVec.empty()) {
-                    outs() << ": " << Dataflow::bitVectorExprToString(setMap.lookup(B), this->exprVec) << "\n";
+            if (numbering.blockIndex(B) < setMap.rows()) {
+                if (domain && !domain->exprVec.empty()) {
+                    outs() << ": " << Dataflow::bitVectorExprToString(setMap, numbering.blockIndex(B), domain->exprVec) << "\n";
                 } else { outs() << ": <ExprVec empty>\n"; }
             }
             else { outs() << ": <Not computed>\n"; }
@@ -993,455 +2069,1767 @@ private:
 // =============================================================================
 // Implementation of the new PM run method for LazyCodeMotion (REVISED)
 // =============================================================================
-PreservedAnalyses LazyCodeMotion::run(Function &F, FunctionAnalysisManager &AM) {
-    // *** ADD THIS FLAG ***
-    // Set to true for LCM-E (insert based on earliest), false for LCM-L (insert based on insertSets)
-    // --> CHANGE THIS VALUE TO 'true' TO RUN IN EARLIEST MODE <--
-  bool useEarliestInsertion = false; // Default to LCM-L (like original behavior)
- //bool useEarliestInsertion = true;    // Default to LCM-E
+bool LazyCodeMotion::hoistLoopInvariants(Function &, LoopInfo &LI, const ExpressionDomain *D) {
+    hoistedPerDepth.clear();
+    // Depth of the loop each hoisted instruction left last: an invariant moved to
+    // an inner preheader moves again with the outer loop and is counted once, there
+    DenseMap<Instruction*, unsigned> leftDepth;
+    SmallVector<Loop*, 8> loops = LI.getLoopsInPreorder();
+    for (Loop *L : reverse(loops)) { // Every loop after the loops inside it
+        BasicBlock *Preheader = L->getLoopPreheader();
+        if (!Preheader) {
+            LCM_LOG(2, outs() << "LCM: Loop at " << getShortValueName(L->getHeader()) << " has no preheader. Skipping.\n");
+            continue;
+        }
+        const unsigned depth = L->getLoopDepth();
+        LoopBlocksRPO RPO(L); // Definitions before uses, so chains of invariants move together
+        RPO.perform(&LI);
+        for (BasicBlock *BB : RPO) {
+            for (Instruction &I : make_early_inc_range(*BB)) {
+                if (!Expression::isCandidate(I) || !L->hasLoopInvariantOperands(&I) || !isSafeToSpeculativelyExecute(&I))
+                    continue;
+                LCM_LOG(2, outs() << "  Hoisting to " << getShortValueName(Preheader) << " (depth " << depth << "): ";
+                           I.print(outs()); outs() << "\n");
+                if (D) changes.changing(&I, *D);
+                I.moveBefore(Preheader->getTerminator());
+                if (D) changes.inserted(&I);
+                leftDepth[&I] = depth;
+            }
+        }
+    }
+    for (auto &[I, depth] : leftDepth) {
+        (void)I;
+        if (hoistedPerDepth.size() <= depth) hoistedPerDepth.resize(depth + 1);
+        hoistedPerDepth[depth]++;
+    }
+    NumLoopHoisted += leftDepth.size();
+    return !leftDepth.empty();
+}
 
+void LazyCodeMotion::reportHoists(Function &F) const {
+    unsigned total = 0;
+    for (unsigned n : hoistedPerDepth) total += n;
+    LCM_LOG(1, outs() << "LCM: " << F.getName() << ": hoisted " << total << " loop invariants (";
+               for (unsigned d = 1; d < hoistedPerDepth.size(); ++d)
+                   outs() << (d > 1 ? ", " : "") << "depth " << d << ": " << hoistedPerDepth[d];
+               outs() << ")\n");
+}
+
+PreservedAnalyses LazyCodeMotion::run(Function &F, FunctionAnalysisManager &AM) {
     bool Changed = false; // Track if the IR is modified
 
-    // --- Clear state ---
-    insertedTempsMap.clear();
-    replacementMap.clear();
-    originalInstructions.clear();
-    earliestSets.clear();
-    latest_inSets.clear();
-    insertSets.clear();
-
-    // --- Get prerequisite analysis results ---
-    auto &AvailResult = AM.getResult<AvailableExpressions>(F);
-    auto &AnticResult = AM.getResult<AnticipatedExpressions>(F);
-    auto &UsedResult = AM.getResult<UsedExpressions>(F);
     auto &DT = AM.getResult<DominatorTreeAnalysis>(F); // Get Dominator Tree
 
-    // --- Copy domain info ---
-    if (AvailResult.numExpr == 0 || AvailResult.exprVec.empty()) {
-        outs() << "LCM: No expressions found or domain empty in function " << F.getName() << ". Skipping.\n";
+    // --- -lcm-loop-aware: hoist loop invariants before anything is solved ---
+    changes.clear();
+    if (LoopAware && hoistLoopInvariants(F, AM.getResult<LoopAnalysis>(F), AM.getCachedResult<ExpressionDomainAnalysis>(F))) {
+        reportHoists(F);
+        AM.invalidate(F, updateAnalyses(F, AM)); // Instructions moved; the CFG did not change
+        Changed = true;
+    }
+
+    // --- Prerequisite analysis results ---
+    // Cached by the analysis manager, or on large functions solved here in
+    // parallel and kept only for this run. Level 3 prints the tables from the
+    // solvers, so it stays sequential.
+    const ExpressionDomain &D = AM.getResult<ExpressionDomainAnalysis>(F);
+    const bool concurrent = ConcurrentAnalysesMinBlocks && F.size() >= ConcurrentAnalysesMinBlocks && LCMVerbose < 3;
+    std::optional<DataflowResult> ownAvail, ownAntic;
+    if (concurrent) solveConcurrently(F, D, ownAvail, ownAntic);
+    const DataflowResult &Avail = concurrent ? *ownAvail : AM.getResult<AvailableExpressions>(F);
+    const DataflowResult &Antic = concurrent ? *ownAntic : AM.getResult<AnticipatedExpressions>(F);
+
+    // --- Steps 1-3 over the shared expression domain (same cached result the analyses used) ---
+    PlacementStatus status = computePlacementSets(F, D, Avail, Antic);
+    if (status != Placed) {
+        reportSkipped(F, status);
+        return Changed ? updateAnalyses(F, AM) : PreservedAnalyses::all();
+    }
+
+    // --- Phases 1-3: rewrite F, splitting the edges that receive computations ---
+    Changed |= applyPlacement(F, DT);
+
+    // --- Determine Preserved Analyses ---
+    if (!Changed) {
         return PreservedAnalyses::all();
+    } else {
+        // Instruction-level analyses are updated or invalid. The CFG only changed
+        // through SplitCriticalEdge, which kept the dominator tree up to date.
+        return updateAnalyses(F, AM);
     }
-    exprMap = AvailResult.exprMap;
-    exprVec = AvailResult.exprVec;
-    numExpr = AvailResult.numExpr;
-
-    // Collect all original binary instructions for later processing
-    for(auto& BB : F) {
-        for(auto& I : BB) {
-            if (auto *BO = dyn_cast<BinaryOperator>(&I)) {
-                 Expression e(BO);
-                 if (e.isValid()) { originalInstructions.insert(BO); }
-             }
-         }
-     }
+}
 
-    // --- Get dataflow states (IN/OUT sets) ---
-    const auto& availStates = AvailResult.df.getStates();
-    const auto& anticStates = AnticResult.df.getStates();
-    const auto& usedStates = UsedResult.df.getStates();
+// Same fixpoint, row by row (the layouts may differ)
+static bool sameFixpoint(const DataflowResult &A, const DataflowResult &B) {
+    for (auto [X, Y] : {std::make_pair(&A.in(), &B.in()), std::make_pair(&A.out(), &B.out())}) {
+        if (X->rows() != Y->rows() || X->cols() != Y->cols()) return false;
+        SmallVector<BitMatrix::Word, 8> rowX(X->wordsPerRow()), rowY(Y->wordsPerRow());
+        for (unsigned r = 0; r < X->rows(); ++r) {
+            if (!BitMatrix::equalWords(X->readRow(r, rowX.data()), Y->readRow(r, rowY.data()), X->wordsPerRow())) return false;
+        }
+    }
+    return true;
+}
 
+// Updates AnalysisT's cached result, if there is one, and keeps it. A result
+// the change reaches too much of is dropped and recomputed when next needed.
+template <typename AnalysisT>
+static void updateCachedResult(Function &F, FunctionAnalysisManager &AM, const ExpressionDomain &D,
+                               const DomainDelta *Delta, PreservedAnalyses &PA) {
+    DataflowResult *R = AM.getCachedResult<AnalysisT>(F);
+    if (!R) return;
+    if (Delta && !AnalysisT().update(F, D, *Delta, *R)) return;
+    if (VerifyUpdates && !sameFixpoint(*R, AnalysisT().compute(F, D)))
+        report_fatal_error(Twine("lcm: updated ") + demangle(typeid(AnalysisT).name()) + " result of " + F.getName() +
+                           " differs from a fresh solve");
+    PA.preserve<AnalysisT>();
+}
 
-    // --- Step 1: Calculate EARLIEST[B] = ANTIC_IN[B] & ! (AVAIL_IN[B] | USED_IN[B]) ---
-    // Using: EARLIEST[B] = ANTIC_IN[B] & (~AVAIL_IN[B] | USED_IN[B])
-    outs() << "LCM: Calculating EARLIEST sets...\n"; outs().flush();
-    for (auto &BB : F) {
-        BasicBlock* B = &BB; BitVector earliest_b(numExpr);
-        auto avail_it = availStates.find(B);
-        auto antic_it = anticStates.find(B);
-        auto used_it = usedStates.find(B);
+PreservedAnalyses LazyCodeMotion::updateAnalyses(Function &F, FunctionAnalysisManager &AM) {
+    PreservedAnalyses PA = PreservedAnalyses::none();
+    PA.preserve<DominatorTreeAnalysis>();
+    // Not updated, but recomputed on next use: the domain under
+    // -lcm-value-numbering, where a rewrite can move the leader of a class and
+    // re-key expressions in blocks it never touched, and under -lcm-loads,
+    // whose kills come from a memory SSA the rewrite invalidated
+    if (UpdateAnalyses && (ValueNumbering || LoadExpressions)) {
+        LCM_LOG(2, outs() << "LCM: Recomputing the analyses of " << F.getName() << " on next use ("
+                          << (ValueNumbering ? "-lcm-value-numbering" : "-lcm-loads") << " is not updated)\n");
+        changes.clear();
+        return PA;
+    }
+    ExpressionDomain *D = UpdateAnalyses ? AM.getCachedResult<ExpressionDomainAnalysis>(F) : nullptr;
+    if (!D) { changes.clear(); return PA; } // Nothing cached to keep
+
+    std::optional<DomainDelta> Delta;
+    if (!changes.empty()) {
+        Delta = D->update(F, changes);
+        changes.clear();
+        LCM_LOG(2, outs() << "LCM: Updating cached analyses of " << F.getName() << " (" << Delta->affected.count() << " of "
+                          << D->numExpr << " expressions affected, " << Delta->dirty.count() << " dirty blocks)\n");
+    }
+    if (VerifyUpdates) {
+        ExpressionDomain fresh = ExpressionDomain::build(F);
+        bool same = fresh.numExpr == D->numExpr && fresh.cfg.getNumBlocks() == D->cfg.getNumBlocks();
+        for (unsigned c = 0; same && c < D->numExpr; ++c)
+            same = fresh.exprVec[c] == D->exprVec[c] && fresh.exprVec[c].definingInst == D->exprVec[c].definingInst;
+        for (unsigned b = 0; same && b < D->cfg.getNumBlocks(); ++b) same = fresh.cfg.getBlock(b) == D->cfg.getBlock(b);
+        if (!same) report_fatal_error(Twine("lcm: updated expression domain of ") + F.getName() + " differs from a fresh one");
+    }
+    PA.preserve<ExpressionDomainAnalysis>();
 
-        if (avail_it != availStates.end() && antic_it != anticStates.end() && used_it != usedStates.end()) {
-            const BitVector& avail_in = avail_it->second.In;
-            const BitVector& antic_in = antic_it->second.In;
-            const BitVector& used_in = used_it->second.In;
+    const DomainDelta *DeltaPtr = Delta ? &*Delta : nullptr;
+    updateCachedResult<AvailableExpressions>(F, AM, *D, DeltaPtr, PA);
+    updateCachedResult<AnticipatedExpressions>(F, AM, *D, DeltaPtr, PA);
+    updateCachedResult<UsedExpressions>(F, AM, *D, DeltaPtr, PA);
+    return PA; // Postponable is not updated and goes
+}
+
+void LazyCodeMotion::solveConcurrently(Function &F, const ExpressionDomain &D, std::optional<DataflowResult> &Avail,
+                                       std::optional<DataflowResult> &Antic) {
+    if (!solvePool) solvePool = std::make_unique<ThreadPool>(hardware_concurrency(LCMThreads));
+    solvePool->async([&] { Avail.emplace(AvailableExpressions().compute(F, D)); });
+    solvePool->async([&] { Antic.emplace(AnticipatedExpressions().compute(F, D)); });
+    solvePool->wait(); // Join before EARLIEST reads both
+}
+
+BasicBlock *LazyCodeMotion::splitEdge(BasicBlock *P, BasicBlock *S, DominatorTree &DT, ExpressionChanges *changes) {
+    Instruction *TI = P->getTerminator();
+    for (unsigned i = 0; i < TI->getNumSuccessors(); ++i) {
+        if (TI->getSuccessor(i) != S || !isCriticalEdge(TI, i)) continue;
+        BasicBlock *NewBB = SplitCriticalEdge(TI, i, CriticalEdgeSplittingOptions(&DT).setMergeIdenticalEdges());
+        if (NewBB) {
+            LCM_LOG(2, outs() << "  Split critical edge " << getShortValueName(P) << " -> " << getShortValueName(S)
+                              << " (new block " << getShortValueName(NewBB) << ")\n");
+            NumEdgesSplit++;
+            if (changes) changes->edgeSplit(P, NewBB, S);
+        }
+        return NewBB;
+    }
+    return nullptr;
+}
+
+LazyCodeMotion::PlacementStatus LazyCodeMotion::computePlacementSets(Function &F, const ExpressionDomain &D,
+        const DataflowResult &Avail, const DataflowResult &Antic) {
+    // Set to true for LCM-E (insert at the earliest points), false for LCM-L (the latest)
+    // --> CHANGE THIS VALUE TO 'true' TO RUN IN EARLIEST MODE <-- (or pass -lcm-earliest)
+  bool useEarliestInsertion = EarliestInsertion; // Default to LCM-L (like original behavior)
+ //bool useEarliestInsertion = true;    // Default to LCM-E
 
-            BitVector not_avail = avail_in; not_avail.flip(); // ~AVAIL_IN
-            BitVector not_avail_or_used = not_avail;
-            not_avail_or_used |= used_in; // ~AVAIL_IN | USED_IN
+    // --- Clear state ---
+    edgeInserts.clear();
+    latestVisits = 0;
+
+    domain = &D;
+    if (domain->numExpr == 0) {
+        LCM_LOG(2, outs() << "LCM: No expressions found or domain empty in function " << F.getName() << ". Skipping.\n");
+        return NoExpressions;
+    }
+    const unsigned numExpr = domain->numExpr;
+
+    // --- Get dataflow matrices (IN/OUT rows per block) ---
+    // All analyses share the domain's block numbering, so row b is the same block everywhere.
+    const BlockNumbering &numbering = domain->cfg;
+    const BitMatrix& availOut = Avail.out();
+    const BitMatrix& anticIn = Antic.in();
+    const BitMatrix& anticOut = Antic.out();
+    const unsigned numBlocks = numbering.getNumBlocks();
+    const unsigned nWords = BitMatrix::wordsFor(numExpr);
+    if (availOut.rows() != numBlocks || anticIn.rows() != numBlocks) return CFGMismatch;
+    // The LCM sets follow the layout the analyses chose; rows are decoded into these when sparse
+    SmallVector<BitMatrix::Word, 8> rowA(nWords), rowB(nWords), rowC(nWords), rowD(nWords);
+    std::optional<TimeRegion> stage; // Times the current step with -lcm-time-stages
+
+    // Local properties, from ANTIC's GEN/KILL: ANTLOC (computed in the block
+    // before anything kills it) and KILL (an operand or phi defined, or for
+    // loads the memory written, anywhere in the block)
+    AnticipatedExpressions::Solver local;
+    {
+        AnticipatedExpressions genKill;
+        genKill.domain = domain;
+        local.initializeDomain(numbering, numExpr);
+        genKill.calculateGenKillSets(F, local);
+    }
+    const BitMatrix &antLoc = local.gen(), &kill = local.kill();
+
+
+    // --- Step 1: EARLIEST[P->S] = ANTIC_IN[S] & ~AVAIL_OUT[P] & (KILL[P] | ~ANTIC_OUT[P]) ---
+    // Computed on every path from S, not available at the end of P, and could not
+    // go above P. Only the part that depends on P is kept, one row per block.
+    LCM_LOG(2, outs() << "LCM: Calculating EARLIEST sets...\n");
+    stage.emplace(stageTimer(StageEarliest));
+    earliestSets.assign(numBlocks, numExpr, false, anticIn.getLayout());
+    for (unsigned b = 0; b < numBlocks; ++b) {
+        BitMatrix::Word *earliest_b = earliestSets.rowForWrite(b, rowD.data());
+        BitMatrix::earliestWords(earliest_b, availOut.readRow(b, rowA.data()), kill.readRow(b, rowB.data()),
+                                 anticOut.readRow(b, rowC.data()), numExpr);
+        earliestSets.storeRow(b, earliest_b);
+    }
+    LCM_LOG(3, printSetMap("EARLIEST (out-edges)", F, numbering, earliestSets));
+
+
+    // --- Step 2: LATER (Forward dataflow on the worklist engine, LCM-L only) ---
+    // LATER[P->S] = EARLIEST[P->S] | (LATERIN[P] & ~ANTLOC[P]), LATERIN[S] = AND of LATER over S's in-edges.
+    // Every LATER edge lies within ANTIC_IN of its target, so as a gen/kill problem
+    // with IN = AND of the preds' OUT (ALL at the entry: the edge into the function)
+    // LATERIN = IN & ANTIC_IN, and OUT = (IN - KILL) | GEN with GEN = earliestSets
+    // and KILL = ~ANTIC_IN | ANTLOC gives LATER[P->S] = ANTIC_IN[S] & OUT[P].
+    BitMatrix laterOut, laterMeet;
+    if (!useEarliestInsertion) {
+        LCM_LOG(2, outs() << "LCM: Calculating LATER sets...\n");
+        stage.emplace(stageTimer(StageLatest));
+        DataflowSolver<Dataflow::FORWARD, IntersectMeet, GenKillTransfer> latestDf;
+        latestDf.initializeDomain(numbering, numExpr);
+        for (unsigned b = 0; b < numBlocks; ++b) {
+            latestDf.gen().storeRow(b, earliestSets.readRow(b, rowA.data()));
+            BitMatrix::Word *kill_b = latestDf.kill().rowForWrite(b, rowD.data());
+            BitMatrix::laterKillWords(kill_b, anticIn.readRow(b, rowA.data()), antLoc.readRow(b, rowB.data()), numExpr);
+            latestDf.kill().storeRow(b, kill_b);
+        }
+        latestDf.setBoundary(Dataflow::ALL) // Entry block: the edge into the function
+                .setInitial(Dataflow::ALL)  // Greatest fixpoint
+                .setVisitBudget(LatestVisitBudget);
+        latestDf.run(F, "LATER");
+        latestVisits = latestDf.getNumIterations();
+        // A partial greatest fixpoint over-approximates LATER, so placing from it is unsafe
+        if (!latestDf.hasConverged()) return BudgetExhausted;
+        LCM_LOG(2, outs() << "LCM: LATER converged after " << latestDf.getNumIterations() << " block visits ("
+                          << numBlocks << " blocks, " << latestDf.getNumSCCs() << " SCCs)\n");
+        latestDf.releaseResults(laterMeet, laterOut);
+        laterInSets.assign(numBlocks, numExpr, false, laterMeet.getLayout());
+        for (unsigned b = 0; b < numBlocks; ++b) {
+            BitMatrix::Word *laterIn_b = laterInSets.rowForWrite(b, rowD.data());
+            BitMatrix::copyWords(laterIn_b, laterMeet.readRow(b, rowA.data()), nWords);
+            BitMatrix::andWords(laterIn_b, anticIn.readRow(b, rowB.data()), nWords);
+            laterInSets.storeRow(b, laterIn_b);
+        }
+        LCM_LOG(3, printSetMap("LATERIN", F, numbering, laterInSets));
+    }
 
-            earliest_b = antic_in;
-            earliest_b &= not_avail_or_used; // ANTIC_IN & (~AVAIL_IN | USED_IN)
 
-        } else {
-             errs() << "Warning: Missing state for block " << (B->hasName() ? B->getName().str() : "<anon>") << " in Earliest calculation.\n";
+    // --- Step 3: INSERT on the edges, DELETE in the blocks ---
+    // LCM-L: INSERT[P->S] = LATER[P->S] & ~LATERIN[S], DELETE[S] = ANTLOC[S] & ~LATERIN[S]
+    // LCM-E: INSERT[P->S] = EARLIEST[P->S] (and ANTIC_IN on the edge into the function), DELETE[S] = ANTLOC[S]
+    LCM_LOG(2, outs() << "LCM: Calculating INSERT and DELETE sets...\n");
+    stage.emplace(stageTimer(StageInsert));
+    const BitMatrix &edgeSource = useEarliestInsertion ? earliestSets : laterOut;
+    deleteSets.assign(numBlocks, numExpr, false, antLoc.getLayout()); // DELETE is a subset of ANTLOC
+    SmallVector<BitMatrix::Word, 8> insertMask(nWords), edge(nWords);
+    auto addEdge = [&](BasicBlock *From, BasicBlock *To, const BitMatrix::Word *exprs) {
+        EdgeInsert EI{From, To, {}};
+        for (unsigned w = 0; w < nWords; ++w)
+            for (BitMatrix::Word x = exprs[w]; x; x &= x - 1) EI.exprs.push_back(w * BitMatrix::BitsPerWord + __builtin_ctzll(x));
+        if (!EI.exprs.empty()) edgeInserts.push_back(std::move(EI));
+    };
+    for (unsigned b = 0; b < numBlocks; ++b) {
+        // The part of INSERT[P->S] and DELETE[S] that depends on S
+        BitMatrix::copyWords(insertMask.data(), anticIn.readRow(b, rowA.data()), nWords);
+        BitMatrix::Word *delete_b = deleteSets.rowForWrite(b, rowD.data());
+        BitMatrix::copyWords(delete_b, antLoc.readRow(b, rowB.data()), nWords);
+        if (!useEarliestInsertion) {
+            const BitMatrix::Word *laterIn_b = laterInSets.readRow(b, rowC.data());
+            BitMatrix::andNotWords(insertMask.data(), laterIn_b, nWords);
+            BitMatrix::andNotWords(delete_b, laterIn_b, nWords);
         }
-        earliestSets[B] = earliest_b;
-     }
-    // printSetMap("EARLIEST", F, earliestSets);
+        deleteSets.storeRow(b, delete_b);
+        if (BitMatrix::noneWords(insertMask.data(), nWords)) continue;
+
+        BasicBlock *S = numbering.getBlock(b);
+        ArrayRef<unsigned> preds = numbering.predIndices(b);
+        if (S->isEntryBlock()) addEdge(nullptr, S, insertMask.data());
+        for (unsigned k = 0; k < preds.size(); ++k) {
+            if (is_contained(preds.take_front(k), preds[k])) continue; // One more edge from the same block
+            BitMatrix::copyWords(edge.data(), insertMask.data(), nWords);
+            BitMatrix::andWords(edge.data(), edgeSource.readRow(preds[k], rowA.data()), nWords);
+            addEdge(numbering.getBlock(preds[k]), S, edge.data());
+        }
+    }
+    LCM_LOG(3, printSetMap("DELETE", F, numbering, deleteSets);
+               outs() << "\n--- INSERT Edges ---\n";
+               for (const EdgeInsert &EI : edgeInserts) {
+                   outs() << (EI.From ? getShortValueName(EI.From) : "<function entry>") << " -> " << getShortValueName(EI.To) << ":";
+                   for (unsigned e : EI.exprs) outs() << " " << domain->exprVec[e].toString();
+                   outs() << "\n";
+               }
+               outs() << "--------------------\n");
+    return Placed;
+}
 
+void LazyCodeMotion::reportSkipped(Function &F, PlacementStatus status) const {
+    if (status == CFGMismatch)
+        errs() << "Warning: Analysis results disagree on the CFG of " << F.getName() << ". Skipping.\n";
+    else if (status == BudgetExhausted)
+        errs() << "Warning: LATER stopped by -lcm-latest-budget after " << latestVisits
+               << " block visits in " << F.getName() << ". Skipping.\n";
+}
 
-    // --- Step 2: Calculate LATEST_IN[B] (Iterative Dataflow) ---
-    // LATEST_IN[B] = (EARLIEST[B] | USED_IN[B]) & meet(LATEST_IN[P]) for P in pred(B)
-    outs() << "LCM: Calculating LATEST_IN sets...\n"; outs().flush();
-    DenseMap<BasicBlock*, BitVector> current_latest_in;
-    for (auto &BB : F) { current_latest_in[&BB] = BitVector(numExpr, true); } // Init to ALL true
+bool LazyCodeMotion::applyPlacement(Function &F, DominatorTree &DT) {
+    bool Changed = false;
+    const std::vector<Expression> &exprVec = domain->exprVec;
+    const unsigned numExpr = domain->numExpr;
+    const BlockNumbering &numbering = domain->cfg;
 
-    bool latest_changed = true; unsigned latest_iterations = 0;
-    const unsigned MAX_LATEST_ITERATIONS = F.size() * 2 + 10; // Adjusted limit
+    // --- Phase 1: Insertion ---
+    // The computations of an edge P->S go to the top of S if P is its only
+    // predecessor, to the end of P if S is its only successor, and otherwise
+    // into a block split off the edge, so only edges that receive something are
+    // split. An expression with an edge none of these fit, or whose operands do
+    // not all reach it (value-numbering leaders), is left where it is.
+    LCM_LOG(2, outs() << "LCM: Phase 1 - Inserting temporary computations...\n");
+    std::optional<TimeRegion> stage(std::in_place, stageTimer(StagePhase1)); // With -lcm-time-stages
+    enum Site { AtTop, AtEnd, OnEdge, Unusable };
+    auto siteOf = [](const EdgeInsert &EI) {
+        if (!EI.From) return AtTop;
+        if (EI.To->getUniquePredecessor() == EI.From) return EI.To->isEHPad() ? Unusable : AtTop;
+        Instruction *TI = EI.From->getTerminator();
+        if (!isa<BranchInst>(TI) && !isa<SwitchInst>(TI)) return Unusable;
+        if (EI.From->getUniqueSuccessor() == EI.To) return AtEnd;
+        return EI.To->isEHPad() ? Unusable : OnEdge;
+    };
+    auto operandsReach = [&](const Expression &e, Instruction *Pos) {
+        for (Value *operand : e.ops) {
+            if (Instruction* op_inst = dyn_cast<Instruction>(operand)) { if (!DT.dominates(op_inst, Pos)) return false; }
+            else if (Argument* op_arg = dyn_cast<Argument>(operand)) { if (op_arg->getParent() != &F) return false; }
+            else if (!isa<Constant>(operand)) { return false; } // Be conservative for other Value types
+        }
+        return true;
+    };
 
-    while (latest_changed && latest_iterations < MAX_LATEST_ITERATIONS) {
-        latest_iterations++; latest_changed = false;
-        for (auto &BB : F) {
-            BasicBlock* B = &BB; BitVector meet_preds(numExpr, true);
-            if (pred_begin(B) != pred_end(B)) {
-                bool first_pred = true;
-                for (BasicBlock* P : predecessors(B)) {
-                    auto pred_latest_it = current_latest_in.find(P);
-                    if (pred_latest_it != current_latest_in.end()) {
-                         if (first_pred) { meet_preds = pred_latest_it->second; first_pred = false; }
-                         else { meet_preds &= pred_latest_it->second; }
-                    } else { meet_preds.reset(); break; } // Error case
+    BitVector dropped(numExpr);
+    SmallVector<Site, 16> sites;
+    for (const EdgeInsert &EI : edgeInserts) {
+        sites.push_back(siteOf(EI));
+        if (EI.From && !DT.isReachableFromEntry(EI.From)) continue; // Never taken; the phis read poison there
+        // A block split off P->S starts where P ends
+        Instruction *Pos = sites.back() == AtTop ? &*EI.To->getFirstInsertionPt() : EI.From->getTerminator();
+        for (unsigned e : EI.exprs) {
+            if (dropped.test(e) || (sites.back() != Unusable && operandsReach(exprVec[e], Pos))) continue;
+            LCM_LOG(2, outs() << "  Left in place (no insertion point on " << getShortValueName(EI.From) << " -> "
+                              << getShortValueName(EI.To) << "): " << exprVec[e].toString() << "\n");
+            dropped.set(e); NumSkippedInsertions++;
+        }
+    }
+
+    // What the rewrite of each expression that moves needs: its values at the
+    // tops and ends of blocks, its temporaries and its computations
+    struct ExprValues {
+        unsigned expr;
+        DenseMap<BasicBlock*, Value*> atTop, atEnd;
+        SmallVector<Instruction*, 4> temps, occs;
+        SmallVector<BasicBlock*, 4> topReaders; // Blocks whose first computation takes the value at their top
+        unsigned replaced = 0;
+    };
+    std::vector<ExprValues> moved;
+    std::vector<int> movedIndex(numExpr, -1);
+    auto movedOf = [&](unsigned e) -> ExprValues& {
+        if (movedIndex[e] < 0) { movedIndex[e] = moved.size(); moved.emplace_back(); moved.back().expr = e; }
+        return moved[movedIndex[e]];
+    };
+    for (const EdgeInsert &EI : edgeInserts)
+        for (unsigned e : EI.exprs) if (!dropped.test(e)) movedOf(e);
+    for (unsigned b = 0; b < numbering.getNumBlocks(); ++b)
+        for (int e = deleteSets.findFirst(b); e != -1; e = deleteSets.findNext(b, e + 1)) if (!dropped.test(e)) movedOf(e);
+    for (unsigned e = 0; e < numExpr; ++e) // The rest only lose their local redundancies
+        if (!dropped.test(e)) movedOf(e);
+
+    unsigned splitCount = 0;
+    for (unsigned k = 0; k < edgeInserts.size(); ++k) {
+        const EdgeInsert &EI = edgeInserts[k];
+        if (EI.From && !DT.isReachableFromEntry(EI.From)) continue;
+        if (all_of(EI.exprs, [&](unsigned e) { return dropped.test(e); })) continue;
+        BasicBlock *B = sites[k] == AtEnd ? EI.From : EI.To;
+        if (sites[k] == OnEdge) {
+            B = splitEdge(EI.From, EI.To, DT, &changes);
+            if (!B) report_fatal_error(Twine("lcm: could not split the edge ") + getShortValueName(EI.From) + " -> " +
+                                       getShortValueName(EI.To) + " in " + F.getName());
+            splitCount++;
+        }
+        Instruction *Pos = sites[k] == AtTop ? &*B->getFirstInsertionPt() : B->getTerminator();
+        for (unsigned e : EI.exprs) {
+            if (dropped.test(e)) continue;
+            Instruction* newInst = exprVec[e].materialize(Pos, "lcm.tmp");
+            LCM_LOG(2, outs() << "  Inserted: "; newInst->print(outs()); outs() << " into " << getShortValueName(B) << "\n");
+            ExprValues &V = movedOf(e);
+            V.temps.push_back(newInst);
+            (sites[k] == AtTop ? V.atTop : V.atEnd)[B] = newInst;
+        }
+    }
+
+
+    // --- Phase 2: The value each computation of a moved expression is replaced with ---
+    // One walk over every block: an expression has the value at the block's top
+    // if the block is in its DELETE set, then that of each computation kept. A
+    // kill leaves none (poison) until the next computation, which is kept; one
+    // with a value before it is redundant. Where the values at the block tops
+    // come from the ends of several blocks, phis join them (pruned SSA).
+    LCM_LOG(2, outs() << "LCM: Phase 2 - Values and phis...\n");
+    stage.emplace(stageTimer(StagePhase2));
+    struct Redundant { Instruction *I; unsigned slot; Value *value; }; // value is null for the block's top value
+    std::vector<Redundant> redundant;
+    SmallDenseMap<unsigned, Value*, 16> current; // Slot in moved -> value here (null: the top value)
+    for (BasicBlock &BB : F) {
+        if (!DT.isReachableFromEntry(&BB)) continue;
+        current.clear();
+        if (int b = numbering.findBlock(&BB); b >= 0) // Blocks split off edges compute only temporaries
+            for (int e = deleteSets.findFirst(b); e != -1; e = deleteSets.findNext(b, e + 1))
+                if (movedIndex[e] >= 0) current[movedIndex[e]] = nullptr;
+        auto killed = [&](unsigned e) { if (movedIndex[e] >= 0) current[movedIndex[e]] = PoisonValue::get(exprVec[e].type); };
+        for (Instruction &I : BB) {
+            if (AnalysisPassBase::definesKillingValue(I)) { for (unsigned e : domain->usersOf(&I)) killed(e); }
+            for (unsigned e : domain->clobberedBy(&I)) killed(e);
+            int idx = domain->exprOf(&I); // Only original computations are numbered
+            if (idx < 0 || movedIndex[idx] < 0) continue;
+            unsigned slot = movedIndex[idx];
+            ExprValues &V = moved[slot];
+            V.occs.push_back(&I);
+            auto it = current.find(slot);
+            if (it == current.end() || isa_and_nonnull<PoisonValue>(it->second)) { current[slot] = &I; continue; }
+            redundant.push_back({&I, slot, it->second});
+            V.replaced++;
+            if (!it->second && (V.topReaders.empty() || V.topReaders.back() != &BB)) V.topReaders.push_back(&BB);
+        }
+        for (auto &[slot, value] : current)
+            if (value) moved[slot].atEnd.try_emplace(&BB, value); // A temporary at the end comes after them all
+    }
+
+    SmallVector<Instruction*, 32> created;
+    for (ExprValues &V : moved) {
+        created.append(V.temps.begin(), V.temps.end());
+        if (V.topReaders.empty()) continue;
+        Type *Ty = exprVec[V.expr].type;
+
+        // The value is live into the blocks from which a top reader is reached
+        // before a definition; phis go where definitions meet among them
+        SmallPtrSet<BasicBlock*, 16> defBlocks, liveIn;
+        for (auto &[BB, Val] : V.atEnd) defBlocks.insert(BB);
+        for (auto &[BB, Val] : V.atTop) defBlocks.insert(BB);
+        SmallVector<BasicBlock*, 16> worklist;
+        for (BasicBlock *B : V.topReaders)
+            if (!V.atTop.count(B) && liveIn.insert(B).second) worklist.push_back(B);
+        while (!worklist.empty()) {
+            BasicBlock *B = worklist.pop_back_val();
+            for (BasicBlock *Pred : predecessors(B))
+                if (DT.isReachableFromEntry(Pred) && !defBlocks.count(Pred) && liveIn.insert(Pred).second)
+                    worklist.push_back(Pred);
+        }
+        SmallVector<BasicBlock*, 16> phiBlocks;
+        ForwardIDFCalculator IDF(DT);
+        IDF.setDefiningBlocks(defBlocks);
+        IDF.setLiveInBlocks(liveIn);
+        IDF.calculate(phiBlocks);
+        SmallVector<PHINode*, 16> phis;
+        for (BasicBlock *B : phiBlocks) {
+            if (V.atTop.count(B)) continue; // Only reached through the insertion
+            auto *Phi = PHINode::Create(Ty, pred_size(B), "lcm.phi", &B->front());
+            V.atTop[B] = Phi;
+            phis.push_back(Phi);
+            created.push_back(Phi);
+        }
+
+        // Without a phi or insertion at its top, a block sees the value its
+        // immediate dominator ends with (climbed iteratively, results cached)
+        auto valueAtTop = [&](BasicBlock *B) -> Value* {
+            SmallVector<BasicBlock*, 16> path;
+            Value *Val = nullptr;
+            for (DomTreeNode *N = DT.getNode(B); !Val; N = N->getIDom()) {
+                if (!N) { Val = PoisonValue::get(Ty); break; }
+                BasicBlock *BB = N->getBlock();
+                if (BB != B && V.atEnd.count(BB)) Val = V.atEnd[BB];
+                else if (auto it = V.atTop.find(BB); it != V.atTop.end()) Val = it->second;
+                else path.push_back(BB);
+            }
+            for (BasicBlock *BB : path) V.atTop[BB] = Val;
+            return Val;
+        };
+        for (PHINode *Phi : phis)
+            for (BasicBlock *Pred : predecessors(Phi->getParent())) {
+                Value *Val = PoisonValue::get(Ty);
+                if (DT.isReachableFromEntry(Pred)) {
+                    auto it = V.atEnd.find(Pred);
+                    Val = it != V.atEnd.end() ? it->second : valueAtTop(Pred);
                 }
-            } // Else: Entry block, meet_preds remains all true
-
-            BitVector new_latest_in_b(numExpr, false);
-            auto earliest_it = earliestSets.find(B); auto used_it = usedStates.find(B);
-            if (earliest_it != earliestSets.end() && used_it != usedStates.end()) {
-                const BitVector& earliest_b_val = earliest_it->second;
-                const BitVector& used_in_b = used_it->second.In;
-                BitVector earliest_or_used = earliest_b_val; earliest_or_used |= used_in_b;
-                new_latest_in_b = earliest_or_used; new_latest_in_b &= meet_preds;
-            } else { /* Error */ }
-
-            auto current_it = current_latest_in.find(B);
-            if (current_it == current_latest_in.end() || current_it->second != new_latest_in_b) {
-                current_latest_in[B] = new_latest_in_b; latest_changed = true;
+                Phi->addIncoming(Val, Pred);
             }
-        } // End block loop
-     } // End while loop
-    if (latest_iterations >= MAX_LATEST_ITERATIONS) { errs() << "Warning: LATEST_IN calc timeout.\n"; }
-    latest_inSets = current_latest_in;
-    // printSetMap("LATEST_IN", F, latest_inSets);
-
-
-    // --- Step 3: Calculate INSERT[B] = LATEST_IN[B] & (EARLIEST[B] | (~LATEST_IN[P] for some P)) ---
-    outs() << "LCM: Calculating INSERT sets...\n"; outs().flush();
-    for (auto &BB : F) {
-        BasicBlock* B = &BB; BitVector insert_b(numExpr, false);
-        auto latest_it = latest_inSets.find(B); auto earliest_it = earliestSets.find(B);
-        if (latest_it == latest_inSets.end() || earliest_it == earliestSets.end()) { insertSets[B] = insert_b; continue; }
-
-        const BitVector& latest_in_b = latest_it->second;
-        const BitVector& earliest_b_val = earliest_it->second;
-        BitVector not_latest_in_preds(numExpr, false); // Is true if E is NOT latest_in ALL predecessors
-        if (pred_begin(B) != pred_end(B)) {
-            for (BasicBlock* P : predecessors(B)) {
-                auto pred_latest_it = latest_inSets.find(P);
-                if (pred_latest_it != latest_inSets.end()) {
-                    BitVector temp = pred_latest_it->second; temp.flip(); // ~LATEST_IN[P]
-                    not_latest_in_preds |= temp; // If *any* pred lacks it, set bit
-                } else { not_latest_in_preds.set(); break; } // Error: Assume condition met
+        for (BasicBlock *B : V.topReaders) valueAtTop(B);
+    }
+
+
+    // --- Phase 3: Perform Replacements and Deletions ---
+    LCM_LOG(2, outs() << "LCM: Phase 3 - Perform Replacements and Deletions...\n");
+    stage.emplace(stageTimer(StagePhase3));
+
+    // Every computation left may now stand for the ones it replaces, so they
+    // all keep only the wrap/exact flags every computation of the expression has
+    for (ExprValues &V : moved) {
+        if (!V.replaced) continue;
+        Instruction *First = V.occs.front();
+        for (Instruction *O : V.occs) First->andIRFlags(O);
+        for (Instruction *I : V.temps) I->copyIRFlags(First);
+        for (Instruction *I : V.occs) I->copyIRFlags(First);
+    }
+
+    // Every temporary and phi is in place, so the values are rewritten in any
+    // order; one expression's replacement may read another's
+    unsigned replacedCount = 0, deletedCount = 0;
+    for (Redundant &R : redundant) {
+        Value *V = R.value ? R.value : moved[R.slot].atTop.lookup(R.I->getParent());
+        LCM_LOG(2, outs() << "  Replacing "; R.I->printAsOperand(outs(), false); outs() << " with ";
+                   V->printAsOperand(outs(), false); outs() << "\n");
+        for (User *U : R.I->users()) {
+            changes.changing(cast<Instruction>(U), *domain);
+            replacedCount++; NumUsesReplaced++;
+        }
+        R.I->replaceAllUsesWith(V);
+    }
+    for (Redundant &R : redundant) {
+        LCM_LOG(2, outs() << "    Deleting: "; R.I->print(outs()); outs() << "\n");
+        changes.erasing(R.I, *domain);
+        R.I->eraseFromParent();
+        deletedCount++; NumDeleted++;
+        Changed = true;
+    }
+
+    // Temporaries and phis nothing else reads go again: those of an expression
+    // left in place, or the loop phis of a value not used after the loop
+    SmallPtrSet<Instruction*, 32> isCreated(created.begin(), created.end()), live;
+    SmallVector<Instruction*, 32> worklist;
+    for (Instruction *I : created) {
+        if (any_of(I->users(), [&](User *U) { return !isCreated.count(cast<Instruction>(U)); }) && live.insert(I).second)
+            worklist.push_back(I);
+    }
+    while (!worklist.empty()) {
+        Instruction *I = worklist.pop_back_val();
+        for (Value *Op : I->operands())
+            if (auto *OpI = dyn_cast<Instruction>(Op); OpI && isCreated.count(OpI) && live.insert(OpI).second)
+                worklist.push_back(OpI);
+    }
+    unsigned insertedCount = 0, phiCount = 0;
+    for (Instruction *I : created) {
+        if (!live.count(I)) { I->dropAllReferences(); continue; }
+        changes.inserted(I);
+        if (isa<PHINode>(I)) { phiCount++; NumPhis++; } else { insertedCount++; NumInserted++; }
+    }
+    for (Instruction *I : created) { if (!live.count(I)) I->eraseFromParent(); }
+    Changed |= splitCount != 0;
+
+    stage.reset();
+    LCM_LOG(1, outs() << "LCM: " << F.getName() << ": " << numExpr << " expressions, split " << splitCount
+                      << " critical edges, inserted " << insertedCount << ", created " << phiCount << " phis, replaced "
+                      << replacedCount << " uses, deleted " << deletedCount << "\n");
+
+
+    return Changed;
+}
+
+// End of LazyCodeMotion::run method implementation
+
+
+//-----------------------------------------------------------------------------
+// 6) Module-level LCM driver (lcm-parallel)
+//-----------------------------------------------------------------------------
+// Runs LazyCodeMotion's stages over every function of the module. Dominator
+// trees, domains, dataflow results and placement sets only read their own
+// function, so they are computed concurrently on a thread pool. Under
+// -lcm-loads the domains also need MemorySSA and alias analysis, which come
+// from the (not thread-safe) function analysis manager, so those are fetched
+// serially in between, after the loop hoist has moved what it moves. The rewrites
+// (with their edge splits) change the IR and may create uniqued constants
+// shared by the whole context, so they run serially in module order
+// afterwards. The output is the same as running the lcm function pipeline.
+class LazyCodeMotionModule : public PassInfoMixin<LazyCodeMotionModule> {
+public:
+    PreservedAnalyses run(Module &M, ModuleAnalysisManager &MAM);
+    static bool isRequired() { return true; }
+
+private:
+    // Everything LCM keeps for one function. Held by pointer, so the domain the
+    // results refer to does not move while other functions are added.
+    struct FunctionState {
+        Function *F = nullptr;
+        DominatorTree DT;
+        ExpressionDomain domain;
+        std::optional<DataflowResult> avail, antic;
+        MemorySSA *mssa = nullptr; // -lcm-loads only
+        AAResults *aa = nullptr;
+        bool hoisted = false; // -lcm-loop-aware moved something
+        LazyCodeMotion lcm;
+        LazyCodeMotion::PlacementStatus status = LazyCodeMotion::NoExpressions;
+
+        // Domain, AVAIL and ANTIC
+        void computeAvailAntic() {
+            domain = ExpressionDomain::build(*F, ValueNumbering ? &DT : nullptr, mssa, aa);
+            avail.emplace(AvailableExpressions().compute(*F, domain));
+            antic.emplace(AnticipatedExpressions().compute(*F, domain));
+        }
+    };
+};
+
+PreservedAnalyses LazyCodeMotionModule::run(Module &M, ModuleAnalysisManager &MAM) {
+    std::vector<std::unique_ptr<FunctionState>> states;
+    for (Function &F : M) {
+        if (F.isDeclaration()) continue;
+        states.push_back(std::make_unique<FunctionState>());
+        states.back()->F = &F;
+    }
+    if (states.empty()) return PreservedAnalyses::all();
+
+    // Level 2 and up log from inside the stages, and a stage timer cannot run on two
+    // threads at once; one worker keeps those lines whole and in order and the timers valid
+    ThreadPool Pool(hardware_concurrency(LCMVerbose >= 2 || TimeStages ? 1 : (unsigned)LCMThreads));
+    auto forEachFunction = [&](auto Fn) {
+        for (auto &S : states) Pool.async([&Fn, State = S.get()] { Fn(*State); });
+        Pool.wait();
+    };
+
+    // --- Concurrent: dominator trees and the loop hoist ---
+    forEachFunction([](FunctionState &S) {
+        S.DT.recalculate(*S.F);
+        if (LoopAware) {
+            LoopInfo LI(S.DT);
+            S.hoisted = S.lcm.hoistLoopInvariants(*S.F, LI);
+        }
+    });
+
+    // --- Serial: MemorySSA and alias analysis for the load expressions ---
+    if (LoadExpressions) {
+        auto &FAM = MAM.getResult<FunctionAnalysisManagerModuleProxy>(M).getManager();
+        for (auto &S : states) {
+            if (S->hoisted) { // Instructions moved; the CFG did not change
+                PreservedAnalyses PA;
+                PA.preserveSet<CFGAnalyses>();
+                FAM.invalidate(*S->F, PA);
             }
-        } else { not_latest_in_preds.set(); } // Entry block: Condition met
+            S->mssa = &FAM.getResult<MemorySSAAnalysis>(*S->F).getMSSA();
+            S->aa = &FAM.getResult<AAManager>(*S->F);
+        }
+    }
 
-        BitVector insert_condition = earliest_b_val; insert_condition |= not_latest_in_preds;
-        insert_b = latest_in_b; insert_b &= insert_condition;
-        insertSets[B] = insert_b;
-     }
-     // printSetMap("INSERT", F, insertSets);
+    // --- Concurrent: analyses and placement sets ---
+    forEachFunction([](FunctionState &S) {
+        S.computeAvailAntic();
+        S.status = S.lcm.computePlacementSets(*S.F, S.domain, *S.avail, *S.antic);
+    });
+
+    // --- Serial: split the edges that receive computations and rewrite, in module order ---
+    bool Changed = false;
+    for (auto &S : states) {
+        if (S->hoisted) { S->lcm.reportHoists(*S->F); Changed = true; }
+        if (S->status == LazyCodeMotion::Placed) Changed |= S->lcm.applyPlacement(*S->F, S->DT);
+        else S->lcm.reportSkipped(*S->F, S->status);
+    }
 
+    return Changed ? PreservedAnalyses::none() : PreservedAnalyses::all();
+}
 
-    // --- Phase 1: Insertion ---
-    // *** MODIFIED TO SUPPORT E/L SWITCH ***
-    outs() << "LCM: Phase 1 - Inserting temporary computations (" << (useEarliestInsertion ? "Earliest Mode" : "Latest Mode") << ")...\n"; outs().flush();
-    insertedTempsMap.clear();
-
-    for (auto &BB : F) {
-        BasicBlock* B = &BB;
-
-        // *** CHOOSE THE SET BASED ON THE FLAG (REVISED W/ find) ***
-        const BitVector* set_to_use = nullptr;
-        if (useEarliestInsertion) {
-            // In Earliest mode, we insert if the expression is in EARLIEST[B]
-            auto it = earliestSets.find(B); // Use find to get iterator
-            if (it != earliestSets.end()) {
-                set_to_use = &it->second; // Take address of the value in the map
-            } else {
-                 errs() << "Warning: Missing EARLIEST set for block " << (B->hasName() ? B->getName().str() : "<anon>") << " in E-mode insertion.\n";
-                 continue; // Skip block if set missing
+
+//-----------------------------------------------------------------------------
+// 7) SSAPRE (New PM) - sparse alternative to the bit-vector LCM (ssapre)
+//-----------------------------------------------------------------------------
+// Chow et al., "A New Algorithm for Partial Redundancy Elimination based on
+// SSA Form". Each expression of the domain is handled on its own, through its
+// occurrences, the Φs of its hypothetical temporary h and their incoming edges:
+// Φ-Insertion, Rename, DownSafety, WillBeAvail, Finalize and CodeMotion. No
+// blocks x expressions matrix is built: the work follows the occurrences and
+// the blocks each expression is live in, not the function size times its
+// expressions.
+//
+// Expressions are the domain's keys. Their operands are SSA
+// values, never redefined, so the only kill of h is the definition of the
+// later operand: Φs go only in blocks it strictly dominates, and an edge
+// leaving that region ends h like a return does.
+class SSAPRE : public PassInfoMixin<SSAPRE> {
+public:
+    PreservedAnalyses run(Function &F, FunctionAnalysisManager &AM);
+    static bool isRequired() { return true; }
+
+private:
+    // A definition of h: a real occurrence, a Φ, or none (⊥)
+    struct OccRef {
+        enum Kind { None, Real, Phi } kind = None;
+        unsigned idx = 0;
+    };
+    struct RealOcc {
+        Instruction *I;
+        OccRef def;          // Nearest dominating occurrence after Rename
+        bool reload = false; // Finalize: redundant, takes its value from def
+    };
+    struct PhiOperand {
+        BasicBlock *pred;
+        OccRef def;
+        bool hasRealUse = false; // A real occurrence lies between def and the edge
+        bool insert = false;     // Finalize: compute the expression at the end of pred
+    };
+    struct PhiOcc {
+        BasicBlock *BB;
+        SmallVector<PhiOperand, 2> ops;
+        SmallVector<std::pair<unsigned, unsigned>, 2> users; // (Φ, operand) defined by this Φ
+        bool downSafe = true, canBeAvail = true, later = true;
+        PHINode *phi = nullptr;
+        bool willBeAvail() const { return canBeAvail && !later; }
+    };
+    // Everything the steps compute for one expression
+    struct ExprWork {
+        unsigned expr = 0;
+        std::vector<RealOcc> reals;
+        std::vector<PhiOcc> phis;
+    };
+
+    static BasicBlock *regionHead(const Expression &E, DominatorTree &DT);
+    static void placePhis(ArrayRef<Instruction*> occs, BasicBlock *head, DominatorTree &DT,
+                          SmallVectorImpl<BasicBlock*> &phiBlocks, SmallVectorImpl<BasicBlock*> &exits);
+
+    // Φ-Insertion through Finalize. Insertions the current CFG cannot take
+    // (critical edges) are added to critical when allowed, otherwise the Φ
+    // needing them is made unavailable.
+    static void plan(ExprWork &W, const ExpressionDomain &D, ArrayRef<Instruction*> occs, ArrayRef<Instruction*> stops,
+                     DominatorTree &DT, bool splitAllowed, SmallVectorImpl<LazyCodeMotion::Edge> &critical);
+    static void rename(ExprWork &W, DominatorTree &DT, ArrayRef<BasicBlock*> exits, ArrayRef<Instruction*> stops);
+    static void downSafety(ExprWork &W);
+    static void resetCanBeAvail(ExprWork &W, unsigned g);
+    static void willBeAvail(ExprWork &W);
+    static void finalize(ExprWork &W);
+    static bool canInsertAt(BasicBlock *P, BasicBlock *B, bool allowCritical);
+
+    // CodeMotion: PHIs, insertions and the replacements of the redundant occurrences
+    static void codeMotion(ExprWork &W, const Expression &E,
+                           SmallVectorImpl<std::pair<Instruction*, Value*>> &replacements,
+                           SmallVectorImpl<Instruction*> &created);
+    static Value *valueOf(const ExprWork &W, OccRef def);
+
+    struct Engine; // What runSparsePRE needs
+};
+
+// The driver ssapre and mcpre share. Both plan every expression on its own
+// over its occurrences, have the critical edges their insertions need split
+// and plan again over the new CFG, and only then rewrite the IR. Engine
+// supplies the parts that differ:
+//   static bool moves(const Expression &E)    its occurrences are collected
+//   Engine(F, AM, DT, D, occurrences)
+//   void plan(bool splitAllowed, SmallVectorImpl<LazyCodeMotion::Edge> &critical)
+//     plans every expression, adding the critical edges an insertion needs
+//     while they may be split; called once more, without, after a split
+//   void codeMotion(replacements, created)   PHIs, insertions, replacements
+// The created instructions nothing ends up using are dropped again.
+struct SparsePREStats {
+    const char *Name;
+    Statistic &Inserted, &Phis, &Deleted;
+};
+
+template <typename Engine>
+static PreservedAnalyses runSparsePRE(Function &F, FunctionAnalysisManager &AM, const SparsePREStats &S) {
+    auto &DT = AM.getResult<DominatorTreeAnalysis>(F);
+    const ExpressionDomain &D = AM.getResult<ExpressionDomainAnalysis>(F);
+    if (D.numExpr == 0) {
+        LCM_LOG(2, outs() << S.Name << ": No expressions found in function " << F.getName() << ". Skipping.\n");
+        return PreservedAnalyses::all();
+    }
+
+    // Real occurrences of every expression the engine moves, in program order (reachable blocks only)
+    std::vector<SmallVector<Instruction*, 2>> occurrences(D.numExpr);
+    for (BasicBlock &BB : F) {
+        if (!DT.isReachableFromEntry(&BB)) continue;
+        for (Instruction &I : BB) {
+            int idx = D.exprOf(&I);
+            if (idx >= 0 && Engine::moves(D.exprVec[idx])) occurrences[idx].push_back(&I);
+        }
+    }
+    Engine E(F, AM, DT, D, occurrences);
+
+    // --- Plan every expression. Insertions on critical edges need the edge
+    // split first; that changes the CFG, so split them all and plan again. ---
+    unsigned splitCount = 0;
+    for (bool splitAllowed : {true, false}) {
+        SmallVector<LazyCodeMotion::Edge, 8> critical;
+        E.plan(splitAllowed, critical);
+        if (critical.empty()) break;
+        LCM_LOG(2, outs() << S.Name << ": Splitting " << critical.size() << " critical edges for insertions...\n");
+        for (auto &[P, Succ] : critical)
+            if (LazyCodeMotion::splitEdge(P, Succ, DT)) splitCount++;
+    }
+
+    // --- CodeMotion. The IR is rewritten only after every expression has been
+    // moved, so occurrences of other expressions keep the operands they were planned with. ---
+    SmallVector<std::pair<Instruction*, Value*>, 32> replacements;
+    SmallVector<Instruction*, 32> created;
+    E.codeMotion(replacements, created);
+
+    for (auto &[I, V] : replacements) {
+        LCM_LOG(2, outs() << "  Replacing "; I->printAsOperand(outs(), false); outs() << " with ";
+                   V->printAsOperand(outs(), false); outs() << "\n");
+        I->replaceAllUsesWith(V);
+        I->eraseFromParent();
+        S.Deleted++;
+    }
+
+    // PHIs nothing reloads from (and the computations feeding only them) are dropped.
+    // A computation can read a PHI too, once the operand it was built over has
+    // been replaced (value numbering makes occurrences operands of other keys).
+    SmallPtrSet<Instruction*, 32> createdSet(created.begin(), created.end()), live;
+    SmallVector<Instruction*, 32> worklist;
+    for (Instruction *I : created)
+        if (llvm::any_of(I->users(), [&](User *U) { return !createdSet.count(cast<Instruction>(U)); }))
+            if (live.insert(I).second) worklist.push_back(I);
+    while (!worklist.empty()) {
+        for (Value *V : worklist.pop_back_val()->operands())
+            if (auto *I = dyn_cast<Instruction>(V))
+                if (createdSet.count(I) && live.insert(I).second) worklist.push_back(I);
+    }
+    unsigned insertedCount = 0, phiCount = 0;
+    for (Instruction *I : created) {
+        if (!live.count(I)) { I->dropAllReferences(); continue; }
+        if (isa<PHINode>(I)) { phiCount++; S.Phis++; }
+        else { insertedCount++; S.Inserted++; }
+    }
+    for (Instruction *I : created)
+        if (!live.count(I)) I->eraseFromParent();
+
+    LCM_LOG(1, outs() << S.Name << ": " << F.getName() << ": " << D.numExpr << " expressions, split " << splitCount
+                      << " critical edges, inserted " << insertedCount << ", created " << phiCount
+                      << " phis, deleted " << replacements.size() << "\n");
+
+    if (!splitCount && replacements.empty()) return PreservedAnalyses::all();
+    // Only SplitCriticalEdge changed the CFG, and it kept the dominator tree up to date
+    PreservedAnalyses PA = PreservedAnalyses::none();
+    PA.preserve<DominatorTreeAnalysis>();
+    return PA;
+}
+
+BasicBlock *SSAPRE::regionHead(const Expression &E, DominatorTree &DT) {
+    BasicBlock *head = nullptr;
+    for (Value *V : E.ops) {
+        auto *I = dyn_cast<Instruction>(V);
+        if (!I) continue; // Arguments and constants hold everywhere
+        // All definitions dominate every occurrence, so they form a chain; keep the latest
+        if (!head || DT.dominates(head, I->getParent())) head = I->getParent();
+    }
+    return head;
+}
+
+// Pruned Φ-Insertion. h is live into the region blocks from which an
+// occurrence can be reached without leaving the region, found by walking
+// predecessors back from the occurrences (as mem2reg finds live-in blocks).
+// Φs go only there, at the iterated dominance frontier of the occurrences over
+// the DJ graph as ForwardIDFCalculator computes it; unpruned, a chain of
+// frontiers would put a Φ in every later block for each expression. Live
+// blocks with an edge to a dead one, where h dies unused, are returned in exits.
+// Needs the DFS numbers.
+void SSAPRE::placePhis(ArrayRef<Instruction*> occs, BasicBlock *head, DominatorTree &DT,
+                       SmallVectorImpl<BasicBlock*> &phiBlocks, SmallVectorImpl<BasicBlock*> &exits) {
+    DomTreeNode *headNode = head ? DT.getNode(head) : nullptr;
+    auto inRegion = [&](BasicBlock *BB) {
+        DomTreeNode *N = DT.getNode(BB);
+        return N && (!headNode || (N != headNode && headNode->getDFSNumIn() <= N->getDFSNumIn() &&
+                                   N->getDFSNumOut() <= headNode->getDFSNumOut()));
+    };
+    SmallPtrSet<BasicBlock*, 32> live;
+    SmallVector<BasicBlock*, 32> liveOrder; // Discovery order, for deterministic exits
+    for (Instruction *I : occs)
+        if (inRegion(I->getParent()) && live.insert(I->getParent()).second) liveOrder.push_back(I->getParent());
+    for (unsigned i = 0; i < liveOrder.size(); ++i)
+        for (BasicBlock *P : predecessors(liveOrder[i]))
+            if (inRegion(P) && live.insert(P).second) liveOrder.push_back(P);
+    for (BasicBlock *BB : liveOrder)
+        if (llvm::any_of(successors(BB), [&](BasicBlock *S) { return !live.count(S); })) exits.push_back(BB);
+
+    using Entry = std::pair<std::pair<unsigned, unsigned>, DomTreeNode*>; // ((level, preorder), node)
+    std::priority_queue<Entry> PQ; // Deepest first
+    SmallPtrSet<DomTreeNode*, 16> defNodes, visitedPQ, visitedWalk;
+    auto push = [&](DomTreeNode *N) { PQ.push({{N->getLevel(), N->getDFSNumIn()}, N}); };
+    for (Instruction *I : occs)
+        if (DomTreeNode *N = DT.getNode(I->getParent()); defNodes.insert(N).second) push(N);
+
+    SmallVector<DomTreeNode*, 32> walk;
+    while (!PQ.empty()) {
+        DomTreeNode *root = PQ.top().second;
+        const unsigned rootLevel = root->getLevel();
+        PQ.pop();
+        walk.assign(1, root);
+        visitedWalk.insert(root);
+        while (!walk.empty()) {
+            DomTreeNode *N = walk.pop_back_val();
+            for (BasicBlock *S : successors(N->getBlock())) {
+                DomTreeNode *SN = DT.getNode(S);
+                if (SN->getLevel() > rootLevel || !visitedPQ.insert(SN).second) continue; // Not a J-edge out
+                if (!live.count(S)) continue; // Dead, or a kill outside the region
+                phiBlocks.push_back(S);
+                if (!defNodes.count(SN)) push(SN);
             }
-        } else { // Use Latest/Insert mode (default LCM-L behavior)
-            auto it = insertSets.find(B); // Use find to get iterator
-            if (it != insertSets.end()) {
-                 set_to_use = &it->second; // Take address of the value in the map
-            } else {
-                // This might happen if LATEST/INSERT couldn't be computed
-                // errs() << "Warning: Missing INSERT set for block " << B->getName() << " in L-mode insertion.\n";
-                continue; // Skip block if set missing
+            for (DomTreeNode *C : *N)
+                if (visitedWalk.insert(C).second) walk.push_back(C);
+        }
+    }
+    llvm::sort(phiBlocks, [&](BasicBlock *A, BasicBlock *B) {
+        return DT.getNode(A)->getDFSNumIn() < DT.getNode(B)->getDFSNumIn();
+    });
+}
+
+bool SSAPRE::canInsertAt(BasicBlock *P, BasicBlock *B, bool allowCritical) {
+    Instruction *TI = P->getTerminator();
+    // Invoke and friends may define an operand themselves, so nothing goes before them
+    if (!isa<BranchInst>(TI) && !isa<SwitchInst>(TI)) return false;
+    if (allowCritical) return true;
+    for (unsigned i = 0; i < TI->getNumSuccessors(); ++i)
+        if (TI->getSuccessor(i) == B && isCriticalEdge(TI, i, /*AllowIdenticalEdges=*/true)) return false;
+    return true;
+}
+
+// --- Rename: versions of h by a walk over the occurrences in dominator-tree preorder ---
+// Only the blocks holding occurrences, Φs, Φ operands or exits are visited. A
+// stack keeps the occurrences dominating the current point; as nothing kills h
+// inside its region, any of them already holds the value. For an expression
+// that may trap, stops are the calls that may not return: h dies at them as at
+// an exit, unless an occurrence comes first.
+void SSAPRE::rename(ExprWork &W, DominatorTree &DT, ArrayRef<BasicBlock*> exits, ArrayRef<Instruction*> stops) {
+    // Ordered by block preorder number, then Φ, real occurrences and stops (in program order), block end
+    struct Event {
+        enum Kind { PhiDef, RealUse, Stop, PhiOperandUse, Exit } kind;
+        unsigned dfsIn, dfsOut;
+        unsigned idx, opIdx;
+        const Instruction *at = nullptr; // RealUse and Stop
+        unsigned rank() const { return kind == PhiDef ? 0 : kind == RealUse || kind == Stop ? 1 : 2; }
+    };
+    std::vector<Event> events;
+    events.reserve(W.reals.size() + W.phis.size() * 3 + exits.size());
+    auto add = [&](Event::Kind kind, BasicBlock *BB, unsigned idx, unsigned opIdx, const Instruction *at = nullptr) {
+        DomTreeNode *N = DT.getNode(BB);
+        if (!N) return; // Unreachable predecessor: its operand stays ⊥
+        events.push_back({kind, N->getDFSNumIn(), N->getDFSNumOut(), idx, opIdx, at});
+    };
+    for (unsigned r = 0; r < W.reals.size(); ++r) add(Event::RealUse, W.reals[r].I->getParent(), r, 0, W.reals[r].I);
+    for (unsigned f = 0; f < W.phis.size(); ++f) {
+        add(Event::PhiDef, W.phis[f].BB, f, 0);
+        for (unsigned k = 0; k < W.phis[f].ops.size(); ++k) add(Event::PhiOperandUse, W.phis[f].ops[k].pred, f, k);
+    }
+    if (!W.phis.empty()) { // Exits and stops only matter to DownSafety
+        for (BasicBlock *BB : exits) add(Event::Exit, BB, 0, 0);
+        for (Instruction *I : stops) add(Event::Stop, I->getParent(), 0, 0, I);
+    }
+    std::stable_sort(events.begin(), events.end(), [](const Event &A, const Event &B) {
+        if (A.dfsIn != B.dfsIn) return A.dfsIn < B.dfsIn;
+        if (A.rank() != B.rank()) return A.rank() < B.rank();
+        return A.rank() == 1 && A.at->comesBefore(B.at);
+    });
+
+    struct StackEntry { OccRef def; unsigned dfsIn, dfsOut; };
+    SmallVector<StackEntry, 16> stack;
+    for (const Event &Ev : events) {
+        while (!stack.empty() && !(stack.back().dfsIn <= Ev.dfsIn && Ev.dfsOut <= stack.back().dfsOut))
+            stack.pop_back(); // No longer dominates
+        OccRef top = stack.empty() ? OccRef() : stack.back().def;
+        switch (Ev.kind) {
+        case Event::PhiDef:
+            stack.push_back({{OccRef::Phi, Ev.idx}, Ev.dfsIn, Ev.dfsOut});
+            break;
+        case Event::RealUse:
+            W.reals[Ev.idx].def = top;
+            // Pushed even when redundant, so the edges below see a real use
+            stack.push_back({{OccRef::Real, Ev.idx}, Ev.dfsIn, Ev.dfsOut});
+            break;
+        case Event::PhiOperandUse: {
+            PhiOperand &op = W.phis[Ev.idx].ops[Ev.opIdx];
+            op.def = top;
+            op.hasRealUse = top.kind == OccRef::Real;
+            if (top.kind == OccRef::Phi) W.phis[top.idx].users.push_back({Ev.idx, Ev.opIdx});
+            break;
+        }
+        case Event::Stop:
+        case Event::Exit:
+            if (top.kind == OccRef::Phi) W.phis[top.idx].downSafe = false; // h dies unused on some path
+            break;
+        }
+    }
+}
+
+// --- DownSafety: a Φ reaching a non-down-safe Φ without a real use is not down-safe either ---
+void SSAPRE::downSafety(ExprWork &W) {
+    SmallVector<unsigned, 8> worklist;
+    for (unsigned f = 0; f < W.phis.size(); ++f)
+        if (!W.phis[f].downSafe) worklist.push_back(f);
+    while (!worklist.empty()) {
+        unsigned f = worklist.pop_back_val();
+        for (const PhiOperand &op : W.phis[f].ops) {
+            if (op.hasRealUse || op.def.kind != OccRef::Phi || !W.phis[op.def.idx].downSafe) continue;
+            W.phis[op.def.idx].downSafe = false;
+            worklist.push_back(op.def.idx);
+        }
+    }
+}
+
+void SSAPRE::resetCanBeAvail(ExprWork &W, unsigned g) {
+    SmallVector<unsigned, 8> worklist{g};
+    W.phis[g].canBeAvail = false;
+    while (!worklist.empty()) {
+        unsigned h = worklist.pop_back_val();
+        for (auto [f, k] : W.phis[h].users) {
+            PhiOcc &F = W.phis[f];
+            if (F.ops[k].hasRealUse || F.downSafe || !F.canBeAvail) continue;
+            F.canBeAvail = false;
+            worklist.push_back(f);
+        }
+    }
+}
+
+// --- WillBeAvail: CanBeAvail (safe to make available), then Later (no earlier than needed) ---
+void SSAPRE::willBeAvail(ExprWork &W) {
+    SmallVector<unsigned, 8> worklist;
+    for (PhiOcc &F : W.phis) F.later = F.canBeAvail;
+    for (unsigned f = 0; f < W.phis.size(); ++f) {
+        PhiOcc &F = W.phis[f];
+        if (!F.later) continue;
+        for (const PhiOperand &op : F.ops)
+            if (op.def.kind != OccRef::None && op.hasRealUse) { F.later = false; worklist.push_back(f); break; }
+    }
+    while (!worklist.empty()) {
+        unsigned h = worklist.pop_back_val();
+        for (auto [f, k] : W.phis[h].users) {
+            (void)k;
+            if (!W.phis[f].later) continue;
+            W.phis[f].later = false;
+            worklist.push_back(f);
+        }
+    }
+}
+
+// --- Finalize: which real occurrences reload and which Φ operands need an insertion ---
+void SSAPRE::finalize(ExprWork &W) {
+    auto isAvail = [&](OccRef def) {
+        return def.kind == OccRef::Real || (def.kind == OccRef::Phi && W.phis[def.idx].willBeAvail());
+    };
+    for (RealOcc &R : W.reals) R.reload = isAvail(R.def);
+    for (PhiOcc &F : W.phis)
+        for (PhiOperand &op : F.ops) op.insert = F.willBeAvail() && !isAvail(op.def);
+}
+
+void SSAPRE::plan(ExprWork &W, const ExpressionDomain &D, ArrayRef<Instruction*> occs, ArrayRef<Instruction*> stops,
+                  DominatorTree &DT, bool splitAllowed, SmallVectorImpl<LazyCodeMotion::Edge> &critical) {
+    for (Instruction *I : occs) W.reals.push_back({I, OccRef()});
+
+    // --- Φ-Insertion: iterated dominance frontier of the occurrences, inside the region ---
+    BasicBlock *head = regionHead(D.exprVec[W.expr], DT);
+    SmallVector<BasicBlock*, 8> phiBlocks, exits;
+    placePhis(occs, head, DT, phiBlocks, exits);
+    for (BasicBlock *B : phiBlocks) {
+        W.phis.push_back({B, {}, {}});
+        for (BasicBlock *P : predecessors(B)) W.phis.back().ops.push_back({P, OccRef()});
+    }
+
+    rename(W, DT, exits, stops);
+    downSafety(W);
+
+    // CanBeAvail: a Φ that is not down-safe must not get an insertion on a ⊥ edge
+    for (unsigned f = 0; f < W.phis.size(); ++f) {
+        PhiOcc &Phi = W.phis[f];
+        if (Phi.downSafe || !Phi.canBeAvail) continue;
+        if (llvm::any_of(Phi.ops, [](const PhiOperand &op) { return op.def.kind == OccRef::None; }))
+            resetCanBeAvail(W, f);
+    }
+
+    // Until every insertion has a place: Φs whose edges cannot take one are given up
+    for (;;) {
+        willBeAvail(W);
+        finalize(W);
+        bool blocked = false;
+        for (unsigned f = 0; f < W.phis.size(); ++f) {
+            PhiOcc &Phi = W.phis[f];
+            if (!Phi.willBeAvail()) continue;
+            for (PhiOperand &op : Phi.ops) {
+                if (!op.insert || canInsertAt(op.pred, Phi.BB, false)) continue;
+                if (splitAllowed && canInsertAt(op.pred, Phi.BB, true)) {
+                    critical.push_back({op.pred, Phi.BB});
+                } else {
+                    resetCanBeAvail(W, f);
+                    blocked = true;
+                    break;
+                }
             }
         }
-        // -----------------------------------------
-
-        // Check if the chosen set is valid and has any bits set
-        // (set_to_use will be nullptr if find failed)
-        if (!set_to_use || set_to_use->none()) continue;
-        const BitVector& insert_or_earliest_b = *set_to_use; // Dereference the pointer
-        // -----------------------------------------
-
-
-        Instruction *insertBefore = B->getFirstNonPHIOrDbgOrLifetime();
-        if (!insertBefore) { insertBefore = B->getTerminator(); }
-        if (!insertBefore) { errs() << "Warning: No insert point in " << B->getName() <<"\n"; continue; }
-        IRBuilder<> builder(insertBefore);
-        auto& blockInsertedTemps = insertedTempsMap[B]; // Get/create map for block B
-
-        // *** Iterate using the chosen set (insert_or_earliest_b) ***
-        for (int i = insert_or_earliest_b.find_first(); i != -1; i = insert_or_earliest_b.find_next(i)) {
-             if (i >= (int)exprVec.size() || i < 0) continue; // Invalid index
-             const Expression& e = exprVec[i];
-             if (!e.isValid()) continue; // Invalid expression
-
-             // Operand Dominance Check (crucial)
-             bool operands_dominate = true;
-             if (Instruction* op1_inst = dyn_cast<Instruction>(e.v1)) { if (!DT.dominates(op1_inst, insertBefore)) operands_dominate = false; }
-             else if (Argument* op1_arg = dyn_cast<Argument>(e.v1)) { if (op1_arg->getParent() != &F) operands_dominate = false; }
-             else if (!isa<Constant>(e.v1)) { operands_dominate = false; } // Be conservative for other Value types
-             if (Instruction* op2_inst = dyn_cast<Instruction>(e.v2)) { if (!DT.dominates(op2_inst, insertBefore)) operands_dominate = false; }
-             else if (Argument* op2_arg = dyn_cast<Argument>(e.v2)) { if (op2_arg->getParent() != &F) operands_dominate = false; }
-             else if (!isa<Constant>(e.v2)) { operands_dominate = false; } // Be conservative
-
-             if (operands_dominate) {
-                 Value *newVal = builder.CreateBinOp(e.op, e.v1, e.v2, "lcm.tmp");
-                 if (Instruction* newInst = dyn_cast<Instruction>(newVal)) {
-                     outs() << "  Inserted: "; newInst->print(outs()); outs() << " into " << (B->hasName() ? B->getName().str() : "<anon>") << "\n";
-                     blockInsertedTemps[e] = newInst; // Store in block's map
-                     Changed = true;
-                 }
-             } else {
-                 outs() << "  Skipped Insertion (Dominance): " << e.toString() << " in " << (B->hasName() ? B->getName().str() : "<anon>") << "\n";
-             }
-        } // End loop over expressions
-     } // End loop over BasicBlocks
-     // *** END OF MODIFIED SECTION FOR E/L SWITCH ***
-
-
-// *** BEGIN SECTION for Critical Edge Detection (Phase 1.5) ***
-    // *** INSTRUMENTED VERSION with Debug Prints ***
-    outs() << "LCM: Phase 1.5 - Checking for potential critical edge insertions...\n"; outs().flush();
-    for (auto &BB : F) {
-        BasicBlock* B = &BB;
-        std::string B_name = B->hasName() ? B->getName().str() : "<anon_block>";
-        outs() << "  Checking Block: " << B_name << "\n"; // DEBUG
-
-        // Check if B has multiple predecessors (is a merge point)
-        auto predIt = pred_begin(B), predEnd = pred_end(B);
-        bool hasMultiplePreds = (predIt != predEnd);
-        if (hasMultiplePreds) { auto checkIt = predIt; checkIt++; if (checkIt == predEnd) { hasMultiplePreds = false; } } // Check for >1 pred
-        outs() << "    Block " << B_name << " has multiple predecessors? " << (hasMultiplePreds ? "Yes" : "No") << "\n"; // DEBUG
-
-        if (hasMultiplePreds) {
-            // Get AVAIL_IN[B] and ANTIC_IN[B]
-            auto avail_in_it = availStates.find(B);
-            auto antic_in_it = anticStates.find(B);
-
-            if (avail_in_it == availStates.end() || antic_in_it == anticStates.end()) {
-                 errs() << "Warning: Missing AVAIL_IN or ANTIC_IN state for multi-pred block " << B_name << " during critical edge check.\n";
-                 continue;
+        if (!blocked) return;
+    }
+}
+
+Value *SSAPRE::valueOf(const ExprWork &W, OccRef def) {
+    while (def.kind == OccRef::Real && W.reals[def.idx].reload) def = W.reals[def.idx].def;
+    if (def.kind == OccRef::Real) return W.reals[def.idx].I;
+    assert(def.kind == OccRef::Phi && W.phis[def.idx].phi && "Reload from an unavailable definition");
+    return W.phis[def.idx].phi;
+}
+
+// --- CodeMotion: PHIs for the available Φs, computations on their ⊥ edges, reloads ---
+void SSAPRE::codeMotion(ExprWork &W, const Expression &E,
+                        SmallVectorImpl<std::pair<Instruction*, Value*>> &replacements,
+                        SmallVectorImpl<Instruction*> &created) {
+    for (PhiOcc &Phi : W.phis)
+        if (Phi.willBeAvail())
+            Phi.phi = PHINode::Create(E.type, Phi.ops.size(), "ssapre.phi", &Phi.BB->front());
+
+    // Reloads may merge values computed with different wrap/exact flags, so
+    // every computation left keeps only the flags all occurrences share
+    Instruction *flags = nullptr;
+    auto intersectFlags = [&](Instruction *I) {
+        if (flags) { I->copyIRFlags(flags); return; }
+        I->copyIRFlags(W.reals.front().I);
+        for (RealOcc &O : W.reals) I->andIRFlags(O.I);
+        flags = I;
+    };
+    for (RealOcc &R : W.reals)
+        if (!R.reload) intersectFlags(R.I);
+
+    for (PhiOcc &Phi : W.phis) {
+        if (!Phi.phi) continue;
+        created.push_back(Phi.phi);
+        for (PhiOperand &op : Phi.ops) {
+            Value *V;
+            if (op.insert) {
+                Instruction *NewI = E.materialize(op.pred->getTerminator(), "ssapre.tmp");
+                intersectFlags(NewI);
+                LCM_LOG(2, outs() << "  Inserted in " << getShortValueName(op.pred) << ": "; NewI->print(outs()); outs() << "\n");
+                created.push_back(NewI);
+                V = NewI;
+            } else {
+                V = valueOf(W, op.def);
             }
-            const BitVector& avail_in_b = avail_in_it->second.In;
-            const BitVector& antic_in_b = antic_in_it->second.In;
-            outs() << "    AVAIL_IN : " << Dataflow::bitVectorExprToString(avail_in_b, exprVec) << "\n"; // DEBUG
-            outs() << "    ANTIC_IN : " << Dataflow::bitVectorExprToString(antic_in_b, exprVec) << "\n"; // DEBUG
-
-            // Iterate through all expressions
-            for(int i = 0; i < numExpr; ++i) {
-                const Expression& e = exprVec[i];
-                if (!e.isValid()) continue;
-                outs() << "      Checking Expr " << i << " [" << e.toString() << "]: ANTIC=" << antic_in_b[i] << ", AVAIL=" << avail_in_b[i] << "\n"; // DEBUG
-
-                // Condition: Expression is ANTICIPATED at B's entry
-                // AND it wasn't already available right at the start of B (AVAIL_IN)
-                if (antic_in_b[i] && !avail_in_b[i]) {
-                    outs() << "        Heuristic PASSED for Expr " << i << " [" << e.toString() << "]\n"; // DEBUG
-
-                    predIt = pred_begin(B); // Reset predecessor iterator before the inner loop
-                    bool reportedForThisExpr = false;
-
-                    // Now check if any incoming edge P->B is critical
-                    outs() << "        Checking Predecessors:\n"; // DEBUG
-                    for (; predIt != predEnd; ++predIt) {
-                        BasicBlock* P = *predIt;
-                        std::string P_name = P->hasName() ? P->getName().str() : "<anon_pred>";
-                        outs() << "          Pred P: " << P_name << "\n"; // DEBUG
-
-                        // Check if P has multiple successors
-                        auto succIt = succ_begin(P), succEnd = succ_end(P);
-                        bool hasMultipleSuccs = (succIt != succEnd);
-                         if (hasMultipleSuccs) { auto checkIt = succIt; checkIt++; if (checkIt == succEnd) { hasMultipleSuccs = false; } } // Check for >1 succ
-                        outs() << "            Pred P has multiple successors? " << (hasMultipleSuccs ? "Yes" : "No") << "\n"; // DEBUG
-
-                        if (hasMultipleSuccs) {
-                             // Edge P->B is critical because P has multiple successors AND B has multiple predecessors.
-                            outs() << "            --> Critical Edge Detected: " << P_name << " -> " << B_name << "\n"; // DEBUG
-                            outs() << "              Info: Expression '" << e.toString()
-                                   << "' might benefit from insertion on critical edge: "
-                                   << P_name << " -> " << B_name
-                                   << " (Code duplication/splitting not implemented).\n"; // Original Info Message
-                            reportedForThisExpr = true;
-                            // Optional: Break after finding the first critical edge for this expression
-                            // if (reportedForThisExpr) break;
-                        }
-                    } // end loop through predecessors P
-                } // end if (antic_in && !avail_in)
-            } // end loop through expressions i
-        } // end if (B has multiple predecessors)
-        outs() << "  Finished Checking Block: " << B_name << "\n"; // DEBUG
-    } // end loop through BasicBlocks BB
-    outs() << "LCM: Phase 1.5 - Finished Checking.\n"; outs().flush(); // DEBUG
-    // *** END SECTION for Critical Edge Detection (Phase 1.5) ***
-
-
-
-    // --- Phase 2: Build Replacement Map (REVISED) ---
-    // For each original instruction, find the highest dominating temporary to replace it with.
-    outs() << "LCM: Phase 2 - Build Replacement Map...\n"; outs().flush();
-    replacementMap.clear(); // Clear map before building
-
-    for (Instruction* I : originalInstructions) {
-         if (auto *BO = dyn_cast<BinaryOperator>(I)) {
-             Expression currentExpr(BO);
-             if (!currentExpr.isValid()) continue;
-
-             // Find the highest dominating temp for this expression and instruction location
-             Instruction* bestReplacement = findHighestDominatingTemp(BO, currentExpr, DT);
-
-             if (bestReplacement && bestReplacement != BO) {
-                 outs() << "  Marking replacement: "; BO->print(outs()); outs() << " -> "; bestReplacement->print(outs()); outs() << "\n";
-                 replacementMap[BO] = bestReplacement; // Map original inst to the chosen temp
-                 // Changed = true; // Marking doesn't change IR yet
-             }
-         }
-     }
+            Phi.phi->addIncoming(V, op.pred);
+        }
+    }
 
+    for (RealOcc &R : W.reals)
+        if (R.reload) replacements.push_back({R.I, valueOf(W, R.def)});
+}
 
-    // --- Phase 3: Perform Replacements and Deletions (REVISED) ---
-    outs() << "LCM: Phase 3 - Perform Replacements and Deletions...\n"; outs().flush();
+// ssapre under runSparsePRE. Loads (-lcm-loads) stay out: the FRG knows no
+// memory kills. Expressions that may trap also see the stops, the
+// instructions execution may not get past.
+struct SSAPRE::Engine {
+    DominatorTree &DT;
+    const ExpressionDomain &D;
+    ArrayRef<SmallVector<Instruction*, 2>> occurrences;
+    SmallVector<Instruction*, 8> stops;
+    BitVector trapping;
+    std::vector<ExprWork> work;
+
+    static bool moves(const Expression &E) { return E.op != Instruction::Load; }
+
+    Engine(Function &F, FunctionAnalysisManager &, DominatorTree &DT, const ExpressionDomain &D,
+           ArrayRef<SmallVector<Instruction*, 2>> occurrences)
+        : DT(DT), D(D), occurrences(occurrences), trapping(D.numExpr) {
+        for (unsigned e : D.trapping) trapping.set(e);
+        if (D.trapping.empty()) return;
+        for (BasicBlock &BB : F) {
+            if (!DT.isReachableFromEntry(&BB)) continue;
+            for (Instruction &I : BB)
+                if (!D.stoppedBy(&I).empty()) stops.push_back(&I);
+        }
+    }
 
-    // Iteratively replace uses until no more changes, handling chains
-    bool replacementOccurred;
-    int replacementIterations = 0;
-    const int MAX_REPLACE_ITER = 10; // Limit iterations
+    void plan(bool splitAllowed, SmallVectorImpl<LazyCodeMotion::Edge> &critical) {
+        DT.updateDFSNumbers();
+        work.assign(D.numExpr, ExprWork());
+        for (unsigned e = 0; e < D.numExpr; ++e) {
+            if (occurrences[e].empty()) continue;
+            work[e].expr = e;
+            ArrayRef<Instruction*> stopsOfE = trapping.test(e) ? ArrayRef<Instruction*>(stops) : ArrayRef<Instruction*>();
+            SSAPRE::plan(work[e], D, occurrences[e], stopsOfE, DT, splitAllowed, critical);
+            if (llvm::none_of(work[e].reals, [](const RealOcc &R) { return R.reload; }))
+                work[e] = ExprWork(); // Nothing becomes redundant
+        }
+    }
+
+    void codeMotion(SmallVectorImpl<std::pair<Instruction*, Value*>> &replacements,
+                    SmallVectorImpl<Instruction*> &created) {
+        for (ExprWork &W : work)
+            if (!W.reals.empty()) SSAPRE::codeMotion(W, D.exprVec[W.expr], replacements, created);
+    }
+};
+
+PreservedAnalyses SSAPRE::run(Function &F, FunctionAnalysisManager &AM) {
+    return runSparsePRE<Engine>(F, AM, {"SSAPRE", NumSSAPREInserted, NumSSAPREPhis, NumSSAPREDeleted});
+}
 
-    do {
-        replacementOccurred = false;
-        replacementIterations++;
 
-        // Need a copy because we might modify instructions during iteration
-        std::vector<Instruction*> instructionsToProcess;
-        for(auto& BB : F) {
-            for(auto& I : BB) {
-                instructionsToProcess.push_back(&I);
+//-----------------------------------------------------------------------------
+// 8) MC-PRE (New PM) - profile-guided speculative PRE (mcpre)
+//-----------------------------------------------------------------------------
+// Cai and Xue, "Optimal and Efficient Speculation-Based Partial Redundancy
+// Elimination". lcm only computes an expression where every path goes on to
+// compute it anyway (the ANTIC_IN term of EARLIEST), so a computation that is
+// partially redundant around a hot loop stays when the way out of the loop
+// skips it. mcpre may speculate it onto such paths when the block frequencies
+// (BlockFrequencyInfo over branch-weight metadata, or the static estimates)
+// say the program then evaluates it fewer times.
+//
+// Each expression gets a flow network, built backwards from the blocks whose
+// first occurrence is upward exposed, over the blocks that leave its value
+// unchanged, to the edges where no value is available: out of a block that
+// defines an operand or that no computation reaches (partial availability),
+// or into the entry. A CFG edge costs its frequency (the
+// computation is placed on it) and every occurrence block b has an edge b ->
+// sink of b's frequency (the computation stays in b). The minimum cut is the
+// placement with the fewest expected evaluations; of the minimum cuts the one
+// nearest the sink is taken, so nothing moves unless it pays. Occurrences
+// beyond the cut become fully redundant and take their value through
+// phis on the iterated dominance frontier. An expression that may trap
+// (division, remainder) is only placed where it is anticipated, so it is never
+// speculated.
+class MCPRE : public PassInfoMixin<MCPRE> {
+public:
+    PreservedAnalyses run(Function &F, FunctionAnalysisManager &AM);
+    static bool isRequired() { return true; }
+
+private:
+    // Residual graph for the minimum cut (Dinic's algorithm, augmenting paths
+    // followed iteratively so long chains of blocks do not exhaust the stack)
+    class FlowNetwork {
+    public:
+        static constexpr uint64_t Infinite = UINT64_MAX / 4;
+
+        unsigned addNode() { adj.emplace_back(); return adj.size() - 1; }
+        // Returns the index of the arc; its reverse is index ^ 1
+        unsigned addEdge(unsigned from, unsigned to, uint64_t cap) {
+            adj[from].push_back(arcs.size()); arcs.push_back({to, std::min(cap, Infinite)});
+            adj[to].push_back(arcs.size()); arcs.push_back({from, 0});
+            return arcs.size() - 2;
+        }
+        uint64_t maxFlow(unsigned s, unsigned t);
+        // After maxFlow: the nodes that still reach t, the sink side of the minimum cut nearest t
+        BitVector sinkSide(unsigned t) const;
+        unsigned head(unsigned arc) const { return arcs[arc].to; }
+        unsigned tail(unsigned arc) const { return arcs[arc ^ 1].to; }
+
+    private:
+        struct Arc { unsigned to; uint64_t cap; }; // Residual capacity
+        std::vector<Arc> arcs;
+        std::vector<SmallVector<unsigned, 4>> adj;
+        std::vector<int> level;
+        std::vector<unsigned> nextArc;
+        bool buildLevels(unsigned s, unsigned t);
+    };
+
+    // Where one expression is computed after MC-PRE
+    struct Placement {
+        unsigned expr = 0;
+        SmallVector<LazyCodeMotion::Edge, 4> inserts;   // Computed on these edges
+        SmallVector<BasicBlock*, 4> redundant;         // Occurrence blocks reached by the value
+        SmallVector<BasicBlock*, 8> beyond;            // Blocks on the sink side of the cut
+        uint64_t before = 0, after = 0;                // Expected evaluations of the occurrences
+    };
+
+    // Plans one expression. Insertions on critical edges go to critical when
+    // they may be split, otherwise such edges cannot be cut; nor can the edges
+    // into a block at whose top computing it is not safe.
+    static bool plan(unsigned e, const Expression &E, ArrayRef<Instruction*> occs, const DominatorTree &DT,
+                     const BlockFrequencyInfo &BFI, const BranchProbabilityInfo &BPI,
+                     function_ref<bool(BasicBlock*, unsigned)> partiallyAvailable,
+                     function_ref<bool(BasicBlock*, unsigned)> safeAtTop, bool splitAllowed,
+                     SmallVectorImpl<LazyCodeMotion::Edge> &critical, Placement &P);
+    static void codeMotion(const Placement &P, const Expression &E, ArrayRef<Instruction*> occs, DominatorTree &DT,
+                           SmallVectorImpl<std::pair<Instruction*, Value*>> &replacements,
+                           SmallVectorImpl<Instruction*> &created);
+
+    struct Engine; // What runSparsePRE needs
+};
+
+bool MCPRE::FlowNetwork::buildLevels(unsigned s, unsigned t) {
+    level.assign(adj.size(), -1);
+    level[s] = 0;
+    std::queue<unsigned> Q;
+    Q.push(s);
+    while (!Q.empty()) {
+        unsigned u = Q.front(); Q.pop();
+        for (unsigned a : adj[u])
+            if (arcs[a].cap && level[arcs[a].to] < 0) {
+                level[arcs[a].to] = level[u] + 1;
+                Q.push(arcs[a].to);
+            }
+    }
+    return level[t] >= 0;
+}
+
+uint64_t MCPRE::FlowNetwork::maxFlow(unsigned s, unsigned t) {
+    uint64_t total = 0;
+    SmallVector<unsigned, 32> path; // Arcs from s to u
+    while (buildLevels(s, t)) {
+        nextArc.assign(adj.size(), 0);
+        unsigned u = s;
+        for (;;) {
+            if (u == t) { // Augment by the bottleneck, then go back to the tail of the first saturated arc
+                uint64_t f = Infinite;
+                for (unsigned a : path) f = std::min(f, arcs[a].cap);
+                for (unsigned a : path) { arcs[a].cap -= f; arcs[a ^ 1].cap += f; }
+                total = std::min(total + f, Infinite);
+                unsigned k = 0;
+                while (arcs[path[k]].cap) ++k;
+                path.resize(k);
+                u = k ? arcs[path[k - 1]].to : s;
+                continue;
             }
+            bool advanced = false;
+            for (; nextArc[u] < adj[u].size(); ++nextArc[u]) {
+                unsigned a = adj[u][nextArc[u]];
+                if (arcs[a].cap && level[arcs[a].to] == level[u] + 1) {
+                    path.push_back(a);
+                    u = arcs[a].to;
+                    advanced = true;
+                    break;
+                }
+            }
+            if (advanced) continue;
+            level[u] = -1; // Dead end for the rest of this phase
+            if (path.empty()) break;
+            path.pop_back();
+            u = path.empty() ? s : arcs[path.back()].to;
         }
+    }
+    return total;
+}
 
-        for(Instruction* userInst : instructionsToProcess) {
-             // Iterate through operands of the user instruction
-             for (unsigned i = 0; i < userInst->getNumOperands(); ++i) {
-                Value *operand = userInst->getOperand(i);
-                if (auto *operandInst = dyn_cast<Instruction>(operand)) {
-                    // Check if this operand instruction should be replaced
-                    // Resolve potential replacement chains
-                    Value* ultimateReplacement = resolveReplacement(operandInst, replacementMap);
-
-                     // If the ultimate replacement is different from the current operand
-                     if (ultimateReplacement && ultimateReplacement != operand) {
-                         // Dominance check for replacement
-                         bool canReplace = false;
-                         if (isa<PHINode>(userInst)) {
-                             // For PHI nodes, the value must dominate the end of the corresponding predecessor block
-                             PHINode *PN = cast<PHINode>(userInst);
-                             BasicBlock *predBlock = PN->getIncomingBlock(i);
-                              // Check if the replacement dominates the predecessor's terminator
-                              if (Instruction* replInst = dyn_cast<Instruction>(ultimateReplacement)) {
-                                   // Use properlyDominates for stricter check if needed, but dominates should suffice
-                                   if (DT.dominates(replInst, predBlock->getTerminator())) {
-                                       canReplace = true;
-                                   }
-                              } else if (isa<Argument>(ultimateReplacement) || isa<Constant>(ultimateReplacement)) {
-                                   canReplace = true; // Constants/Args always dominate
-                              }
-                          } else {
-                              // For non-PHI nodes, the value must dominate the user instruction itself
-                              if (Instruction* replInst = dyn_cast<Instruction>(ultimateReplacement)) {
-                                  if (DT.dominates(replInst, userInst)) {
-                                       canReplace = true;
-                                  }
-                              } else if (isa<Argument>(ultimateReplacement) || isa<Constant>(ultimateReplacement)) {
-                                  canReplace = true;
-                              }
-                         }
-
-                         if (canReplace) {
-                              outs() << "  Replacing operand " << i << " of: "; userInst->print(outs()); outs() << " ("; operand->printAsOperand(outs(), false); outs() << " -> "; ultimateReplacement->printAsOperand(outs(), false); outs() << ")\n";
-                              userInst->setOperand(i, ultimateReplacement);
-                              replacementOccurred = true;
-                              Changed = true;
-                         } else {
-                              // This warning can be noisy if dominance is the intended reason for not replacing
-                              // outs() << "  Skipped replacement (Dominance fail) in: "; userInst->print(outs()); outs() << " operand "; operand->printAsOperand(outs(), false); outs() << " with "; ultimateReplacement->printAsOperand(outs(),false); outs() << "\n";
-                         }
-                    }
-                 }
-             } // End operand loop
-        } // End instruction loop
-
-    } while (replacementOccurred && replacementIterations < MAX_REPLACE_ITER);
-
-    if (replacementIterations >= MAX_REPLACE_ITER) {
-        errs() << "Warning: Replacement phase reached iteration limit.\n";
-    }
-
-
-    // --- Deletion Phase ---
-    // Delete original instructions that were replaced AND are now trivially dead
-    outs() << "  Deleting dead instructions...\n";
-    unsigned deletedCount = 0;
-    // Use LLVM's utility to remove trivially dead instructions, which handles dependencies better
-    // Iterate backwards to potentially make it easier to delete instructions that use other deleted ones
-    SmallVector<Instruction*, 32> toDelete; // Collect instructions to delete
-    for(Instruction* originalInst : originalInstructions) {
-        // Check if this instruction was actually replaced (is in the map)
-        if (replacementMap.count(originalInst)) {
-             // Check if it's trivially dead AFTER replacements have happened
-             if (isInstructionTriviallyDead(originalInst, nullptr)) {
-                 toDelete.push_back(originalInst);
-             } else if (originalInst->use_empty()){
-                 // Sometimes isInstructionTriviallyDead might miss things? Double check use_empty
-                 toDelete.push_back(originalInst);
-             }
+BitVector MCPRE::FlowNetwork::sinkSide(unsigned t) const {
+    BitVector reaches(adj.size());
+    SmallVector<unsigned, 32> worklist{t};
+    reaches.set(t);
+    while (!worklist.empty()) {
+        unsigned v = worklist.pop_back_val();
+        for (unsigned a : adj[v]) { // a: v -> w, so a ^ 1: w -> v
+            unsigned w = arcs[a].to;
+            if (arcs[a ^ 1].cap && !reaches.test(w)) { reaches.set(w); worklist.push_back(w); }
         }
     }
+    return reaches;
+}
 
-    // Now delete them
-    for (Instruction* I : toDelete) {
-         outs() << "    Deleting: "; I->print(outs()); outs() << "\n";
-         I->eraseFromParent();
-         deletedCount++;
-         Changed = true; // Deletion changes IR
-     }
+bool MCPRE::plan(unsigned e, const Expression &E, ArrayRef<Instruction*> occs, const DominatorTree &DT,
+                 const BlockFrequencyInfo &BFI, const BranchProbabilityInfo &BPI,
+                 function_ref<bool(BasicBlock*, unsigned)> partiallyAvailable,
+                 function_ref<bool(BasicBlock*, unsigned)> safeAtTop, bool splitAllowed,
+                 SmallVectorImpl<LazyCodeMotion::Edge> &critical, Placement &P) {
+    SmallPtrSet<BasicBlock*, 4> defBlocks, occBlocks;
+    for (Value *V : E.ops)
+        if (auto *I = dyn_cast<Instruction>(V)) defBlocks.insert(I->getParent());
+    for (Instruction *I : occs) occBlocks.insert(I->getParent());
+
+    auto freq = [&](BasicBlock *BB) { return BFI.getBlockFreq(BB).getFrequency(); };
+    auto edgeFreq = [&](BasicBlock *From, BasicBlock *To) {
+        return (BFI.getBlockFreq(From) * BPI.getEdgeProbability(From, To)).getFrequency();
+    };
+
+    // Nodes 0 (source) and 1 (sink), then one per block; arcs remember their CFG edge
+    FlowNetwork G;
+    const unsigned S = G.addNode(), T = G.addNode();
+    DenseMap<BasicBlock*, unsigned> node;
+    SmallVector<BasicBlock*, 16> worklist;
+    DenseMap<unsigned, LazyCodeMotion::Edge> arcEdge;
+    SmallVector<std::pair<unsigned, BasicBlock*>, 8> keepArcs;
+    auto nodeOf = [&](BasicBlock *BB) {
+        auto [it, inserted] = node.try_emplace(BB, 0);
+        if (inserted) { it->second = G.addNode(); worklist.push_back(BB); }
+        return it->second;
+    };
+    // The cost of computing on P -> B; infinite where nothing can go
+    auto edgeCost = [&](BasicBlock *Pred, BasicBlock *B) -> uint64_t {
+        Instruction *TI = Pred->getTerminator();
+        if (!isa<BranchInst>(TI) && !isa<SwitchInst>(TI)) return FlowNetwork::Infinite;
+        if (!safeAtTop(B, e)) return FlowNetwork::Infinite;
+        if (Pred->getSingleSuccessor() == B) return edgeFreq(Pred, B);
+        if (B->getSinglePredecessor() == Pred) return B->isEHPad() ? FlowNetwork::Infinite : edgeFreq(Pred, B);
+        return splitAllowed ? edgeFreq(Pred, B) : FlowNetwork::Infinite; // Critical
+    };
 
-    // Optional: Run RecursivelyDeleteTriviallyDeadInstructions for broader cleanup of temps etc.
-    // bool cleanupChanged = RecursivelyDeleteTriviallyDeadInstructions(F, nullptr);
-    // Changed |= cleanupChanged;
+    for (Instruction *I : occs) {
+        BasicBlock *BB = I->getParent();
+        if (defBlocks.count(BB) || node.count(BB)) continue; // Not upward exposed, or seen
+        unsigned n = nodeOf(BB);
+        keepArcs.push_back({G.addEdge(n, T, freq(BB)), BB});
+        P.before += freq(BB);
+    }
+    if (keepArcs.empty()) return false;
+
+    while (!worklist.empty()) {
+        BasicBlock *B = worklist.pop_back_val();
+        unsigned b = node[B];
+        if (B->isEntryBlock()) G.addEdge(S, b, FlowNetwork::Infinite); // Nothing is available on entry
+        for (BasicBlock *Pred : predecessors(B)) {
+            if (occBlocks.count(Pred) || !DT.isReachableFromEntry(Pred))
+                continue; // Available at its end, or never reached
+            // No value on any path to the end of Pred: the cut costs no less above it
+            unsigned from = defBlocks.count(Pred) || !partiallyAvailable(Pred, e) ? S : nodeOf(Pred);
+            arcEdge[G.addEdge(from, b, edgeCost(Pred, B))] = {Pred, B};
+        }
+    }
 
-    outs() << "  Deleted " << deletedCount << " original instructions.\n";
+    P.after = G.maxFlow(S, T);
+    if (P.after >= P.before) return false;
+    BitVector sink = G.sinkSide(T);
+    for (auto &[BB, n] : node)
+        if (sink.test(n)) P.beyond.push_back(BB);
+    for (auto &[arc, BB] : keepArcs)
+        if (sink.test(G.tail(arc))) P.redundant.push_back(BB);
+    for (auto &[arc, Edge] : arcEdge) {
+        if (sink.test(G.tail(arc)) || !sink.test(G.head(arc))) continue;
+        P.inserts.push_back(Edge);
+        auto [Pred, B] = Edge;
+        if (Pred->getSingleSuccessor() != B && B->getSinglePredecessor() != Pred) critical.push_back(Edge);
+    }
+    return !P.redundant.empty();
+}
 
+void MCPRE::codeMotion(const Placement &P, const Expression &E, ArrayRef<Instruction*> occs, DominatorTree &DT,
+                       SmallVectorImpl<std::pair<Instruction*, Value*>> &replacements,
+                       SmallVectorImpl<Instruction*> &created) {
+    SmallPtrSet<BasicBlock*, 8> redundant(P.redundant.begin(), P.redundant.end());
+    SmallPtrSet<BasicBlock*, 16> beyond(P.beyond.begin(), P.beyond.end());
+
+    // Every computation left may now feed a use of another occurrence, so
+    // they all keep only the wrap/exact flags every occurrence has
+    auto intersectFlags = [&](Instruction *I) {
+        I->copyIRFlags(occs.front());
+        for (Instruction *O : occs) I->andIRFlags(O);
+    };
 
-    // --- Determine Preserved Analyses ---
-    if (!Changed) {
-        return PreservedAnalyses::all();
-    } else {
-        // Basic invalidation: Assume CFG might change if blocks become empty,
-        // and analyses relying on instruction details are invalid.
-        PreservedAnalyses PA = PreservedAnalyses::none();
-        // DominatorTree might be preserved if no blocks were removed/added,
-        // but let's be conservative and invalidate it unless we use SplitCriticalEdge utils.
-        // PA.preserve<DominatorTreeAnalysis>();
-        return PA;
+    // Definitions: the first occurrence of every block that keeps its
+    // computation (the value at its end), and the insertions
+    DenseMap<BasicBlock*, Value*> atEnd, atTop;
+    for (Instruction *I : occs) {
+        BasicBlock *BB = I->getParent();
+        if (redundant.count(BB) || atEnd.count(BB)) continue;
+        intersectFlags(I);
+        atEnd[BB] = I;
+    }
+    for (auto [Pred, B] : P.inserts) {
+        bool onPred = Pred->getSingleSuccessor() == B;
+        Instruction *Pos = onPred ? Pred->getTerminator() : &*B->getFirstInsertionPt();
+        Instruction *NewI = E.materialize(Pos, "mcpre.tmp");
+        intersectFlags(NewI);
+        LCM_LOG(2, outs() << "  Inserted in " << getShortValueName(NewI->getParent()) << ": "; NewI->print(outs()); outs() << "\n");
+        created.push_back(NewI);
+        (onPred ? atEnd : atTop)[NewI->getParent()] = NewI;
     }
+
+    // The value is live into the blocks beyond the cut from which a redundant
+    // occurrence is reached before a definition; phis go where definitions
+    // meet among them (pruned SSA: one query per expression instead of a walk
+    // per redundant block)
+    SmallPtrSet<BasicBlock*, 16> defBlocks, liveIn;
+    for (auto &[BB, V] : atEnd) defBlocks.insert(BB);
+    for (auto &[BB, V] : atTop) defBlocks.insert(BB);
+    SmallVector<BasicBlock*, 16> worklist;
+    for (BasicBlock *B : P.redundant)
+        if (!atTop.count(B) && liveIn.insert(B).second) worklist.push_back(B);
+    while (!worklist.empty()) {
+        BasicBlock *B = worklist.pop_back_val();
+        for (BasicBlock *Pred : predecessors(B))
+            if (beyond.count(Pred) && !atEnd.count(Pred) && !atTop.count(Pred) && liveIn.insert(Pred).second)
+                worklist.push_back(Pred);
+    }
+    SmallVector<BasicBlock*, 16> phiBlocks;
+    ForwardIDFCalculator IDF(DT);
+    IDF.setDefiningBlocks(defBlocks);
+    IDF.setLiveInBlocks(liveIn);
+    IDF.calculate(phiBlocks);
+    SmallVector<PHINode*, 16> phis;
+    for (BasicBlock *B : phiBlocks) {
+        if (atTop.count(B)) continue; // Only reached through the insertion
+        auto *Phi = PHINode::Create(E.type, pred_size(B), "mcpre.phi", &B->front());
+        atTop[B] = Phi;
+        phis.push_back(Phi);
+        created.push_back(Phi);
+    }
+
+    // Without a phi or insertion at its top, a block sees the value its
+    // immediate dominator ends with (climbed iteratively, results cached)
+    auto valueAtTop = [&](BasicBlock *B) -> Value* {
+        SmallVector<BasicBlock*, 16> path;
+        Value *V = nullptr;
+        for (DomTreeNode *N = DT.getNode(B); !V; N = N->getIDom()) {
+            if (!N) { V = PoisonValue::get(E.type); break; }
+            BasicBlock *BB = N->getBlock();
+            if (BB != B && atEnd.count(BB)) V = atEnd[BB];
+            else if (auto it = atTop.find(BB); it != atTop.end()) V = it->second;
+            else path.push_back(BB);
+        }
+        for (BasicBlock *BB : path) atTop[BB] = V;
+        return V;
+    };
+    auto valueAtEnd = [&](BasicBlock *B) -> Value* {
+        if (auto it = atEnd.find(B); it != atEnd.end()) return it->second;
+        return valueAtTop(B);
+    };
+    for (PHINode *Phi : phis)
+        for (BasicBlock *Pred : predecessors(Phi->getParent()))
+            Phi->addIncoming(DT.isReachableFromEntry(Pred) ? valueAtEnd(Pred) : PoisonValue::get(E.type), Pred);
+
+    DenseMap<BasicBlock*, Value*> blockValue(atEnd);
+    for (BasicBlock *B : P.redundant) blockValue[B] = valueAtTop(B);
+    for (Instruction *I : occs)
+        if (Value *V = blockValue[I->getParent()]; V != I) replacements.push_back({I, V});
 }
 
-// End of LazyCodeMotion::run method implementation
+// mcpre under runSparsePRE. Loads (-lcm-loads) stay out, as in ssapre. An
+// expression that may trap is only cut where it is anticipated (ANTIC_IN,
+// whose kills include the stops), so the cut never speculates it.
+struct MCPRE::Engine {
+    Function &F;
+    FunctionAnalysisManager &AM;
+    DominatorTree &DT;
+    const ExpressionDomain &D;
+    ArrayRef<SmallVector<Instruction*, 2>> occurrences;
+    DataflowSolver<Dataflow::FORWARD, UnionMeet, GenKillTransfer> pavail;
+    BitVector trapping;
+    const DataflowResult *antic = nullptr; // Only if some expression may trap
+    // Frequencies over the CFG once critical edges have been split
+    std::optional<LoopInfo> LI;
+    std::optional<BranchProbabilityInfo> BPI;
+    std::optional<BlockFrequencyInfo> BFI;
+    std::vector<Placement> plans;
+
+    static bool moves(const Expression &E) { return E.op != Instruction::Load; }
+
+    // Partial availability at the end of every block: AVAIL's GEN/KILL with union
+    // at joins. The flow networks stop where it is empty.
+    Engine(Function &F, FunctionAnalysisManager &AM, DominatorTree &DT, const ExpressionDomain &D,
+           ArrayRef<SmallVector<Instruction*, 2>> occurrences)
+        : F(F), AM(AM), DT(DT), D(D), occurrences(occurrences), trapping(D.numExpr) {
+        AvailableExpressions genKill;
+        genKill.domain = &D;
+        pavail.initializeDomain(D.cfg, D.numExpr);
+        genKill.calculateGenKillSets(F, pavail);
+        pavail.setBoundary(Dataflow::EMPTY).setInitial(Dataflow::EMPTY);
+        pavail.run(F, "PartialAvailability");
+        for (unsigned e : D.trapping) trapping.set(e);
+        if (!D.trapping.empty()) antic = &AM.getResult<AnticipatedExpressions>(F);
+    }
+
+    // Blocks split after the analysis are not numbered; one carries the value of its only predecessor
+    bool partiallyAvailable(BasicBlock *BB, unsigned e) const {
+        int b;
+        while ((b = D.cfg.findBlock(BB)) < 0) BB = BB->getSinglePredecessor();
+        return pavail.out().test(b, e);
+    }
+
+    // Whether e may be computed at the top of BB: always, unless it may trap.
+    // A split block computes nothing, so it anticipates what its only successor does.
+    bool safeAtTop(BasicBlock *BB, unsigned e) const {
+        if (!trapping.test(e)) return true;
+        int b;
+        while ((b = D.cfg.findBlock(BB)) < 0) BB = BB->getSingleSuccessor();
+        return antic->in().test(b, e);
+    }
+
+    // The first plan uses the cached frequencies; the one after a split recomputes them
+    void plan(bool splitAllowed, SmallVectorImpl<LazyCodeMotion::Edge> &critical) {
+        const BlockFrequencyInfo *Freq = &AM.getResult<BlockFrequencyAnalysis>(F);
+        const BranchProbabilityInfo *Prob = &AM.getResult<BranchProbabilityAnalysis>(F);
+        if (!splitAllowed) {
+            LI.emplace(DT);
+            BPI.emplace(F, *LI);
+            BFI.emplace(F, *BPI, *LI);
+            Freq = &*BFI; Prob = &*BPI;
+        }
+        auto pavailOf = [&](BasicBlock *BB, unsigned e) { return partiallyAvailable(BB, e); };
+        auto safeOf = [&](BasicBlock *BB, unsigned e) { return safeAtTop(BB, e); };
+        plans.clear();
+        for (unsigned e = 0; e < D.numExpr; ++e) {
+            if (occurrences[e].empty()) continue;
+            Placement P;
+            P.expr = e;
+            if (MCPRE::plan(e, D.exprVec[e], occurrences[e], DT, *Freq, *Prob, pavailOf, safeOf, splitAllowed, critical, P))
+                plans.push_back(std::move(P));
+        }
+    }
+
+    void codeMotion(SmallVectorImpl<std::pair<Instruction*, Value*>> &replacements,
+                    SmallVectorImpl<Instruction*> &created) {
+        for (const Placement &P : plans) {
+            LCM_LOG(2, outs() << "MC-PRE: " << D.exprVec[P.expr].toString() << ": expected evaluations "
+                              << P.before << " -> " << P.after << "\n");
+            MCPRE::codeMotion(P, D.exprVec[P.expr], occurrences[P.expr], DT, replacements, created);
+        }
+    }
+};
+
+PreservedAnalyses MCPRE::run(Function &F, FunctionAnalysisManager &AM) {
+    return runSparsePRE<Engine>(F, AM, {"MC-PRE", NumMCPREInserted, NumMCPREPhis, NumMCPREDeleted});
+}
+
+
+//-----------------------------------------------------------------------------
+// 9) Dynamic operation counts (lcm-count)
+//-----------------------------------------------------------------------------
+// Instruments the module to count, per opcode, how many binary operators it
+// executes, and prints the counts when the program exits. Run it after the
+// transformation (-passes='function(lcm),lcm-count') and without it (-passes=lcm-count) and
+// compare the totals to see what lcm saves at run time:
+//
+//   lcm-count: <module>
+//   lcm-count:   add        1200
+//   lcm-count:   total      1350
+//
+// Each block adds its static count of every opcode to a module-local counter
+// just before its terminator, so the counters cost one load/add/store per
+// opcode per executed block. The updates are not atomic: counts of threaded
+// programs are approximate. The test inputs have no main; -lcm-count-main gives
+// such modules one, so they also run under lli.
+static cl::opt<bool> CountAddMain(
+    "lcm-count-main", cl::init(false),
+    cl::desc("lcm-count: add a main calling every function with integer arguments, if the module has none"));
+static cl::opt<unsigned> CountCalls(
+    "lcm-count-calls", cl::init(16),
+    cl::desc("lcm-count: calls per function made by the -lcm-count-main driver"));
+
+class LCMCountPass : public PassInfoMixin<LCMCountPass> {
+public:
+    PreservedAnalyses run(Module &M, ModuleAnalysisManager &MAM);
+    static bool isRequired() { return true; }
+
+private:
+    static constexpr unsigned NumOpcodes = Instruction::BinaryOpsEnd - Instruction::BinaryOpsBegin;
+
+    static Function *addDriver(Module &M);
+    static Function *addDump(Module &M, GlobalVariable *Counters, ArrayRef<bool> seen);
+};
+
+// main: calls every defined function whose parameters and result are all integers
+// -lcm-count-calls times, with small arguments (loop bounds in the tests stay short)
+Function *LCMCountPass::addDriver(Module &M) {
+    LLVMContext &Ctx = M.getContext();
+    SmallVector<Function*, 8> callees;
+    for (Function &F : M) {
+        if (F.isDeclaration() || F.isVarArg()) continue;
+        bool integers = F.getReturnType()->isIntegerTy() || F.getReturnType()->isVoidTy();
+        for (Argument &A : F.args()) integers &= A.getType()->isIntegerTy();
+        if (integers) callees.push_back(&F);
+    }
+    Function *Main = Function::Create(FunctionType::get(Type::getInt32Ty(Ctx), false),
+                                      Function::ExternalLinkage, "main", M);
+    IRBuilder<> B(BasicBlock::Create(Ctx, "entry", Main));
+    for (unsigned call = 0; call < CountCalls; ++call) {
+        for (Function *F : callees) {
+            SmallVector<Value*, 8> args;
+            for (Argument &A : F->args()) // Spread over -8..24 so both sides of the tests' branches run
+                args.push_back(ConstantInt::getSigned(A.getType(), (int64_t)((call * 7 + A.getArgNo() * 13) % 33) - 8));
+            B.CreateCall(F, args);
+        }
+    }
+    B.CreateRet(B.getInt32(0));
+    return Main;
+}
+
+// Prints the counters of the opcodes that occur in the module, and their total
+Function *LCMCountPass::addDump(Module &M, GlobalVariable *Counters, ArrayRef<bool> seen) {
+    LLVMContext &Ctx = M.getContext();
+    Type *I64 = Type::getInt64Ty(Ctx);
+    FunctionCallee Printf = M.getOrInsertFunction(
+        "printf", FunctionType::get(Type::getInt32Ty(Ctx), {PointerType::getUnqual(Ctx)}, true));
+    Function *Dump = Function::Create(FunctionType::get(Type::getVoidTy(Ctx), false),
+                                      GlobalValue::InternalLinkage, "lcm.count.dump", M);
+    IRBuilder<> B(BasicBlock::Create(Ctx, "entry", Dump));
+    B.CreateCall(Printf, {B.CreateGlobalStringPtr("lcm-count: %s\n"),
+                          B.CreateGlobalStringPtr(M.getModuleIdentifier())});
+    Value *format = B.CreateGlobalStringPtr("lcm-count:   %-10s %llu\n");
+    Value *total = ConstantInt::get(I64, 0);
+    for (unsigned op = 0; op < NumOpcodes; ++op) {
+        if (!seen[op]) continue;
+        Value *n = B.CreateLoad(I64, B.CreateConstInBoundsGEP2_64(Counters->getValueType(), Counters, 0, op));
+        total = B.CreateAdd(total, n);
+        B.CreateCall(Printf, {format, B.CreateGlobalStringPtr(Instruction::getOpcodeName(Instruction::BinaryOpsBegin + op)), n});
+    }
+    B.CreateCall(Printf, {format, B.CreateGlobalStringPtr("total"), total});
+    B.CreateRetVoid();
+    return Dump;
+}
+
+PreservedAnalyses LCMCountPass::run(Module &M, ModuleAnalysisManager &) {
+    LLVMContext &Ctx = M.getContext();
+    Type *I64 = Type::getInt64Ty(Ctx);
+    ArrayType *CountersTy = ArrayType::get(I64, NumOpcodes);
+    auto *Counters = new GlobalVariable(M, CountersTy, false, GlobalValue::InternalLinkage,
+                                        ConstantAggregateZero::get(CountersTy), "lcm.count");
+
+    if (CountAddMain && !M.getFunction("main")) addDriver(M);
+
+    // Count first, then instrument, so the counter updates are not counted themselves
+    SmallVector<bool, NumOpcodes> seen(NumOpcodes, false);
+    for (Function &F : M) {
+        for (BasicBlock &BB : F) {
+            unsigned counts[NumOpcodes] = {};
+            for (Instruction &I : BB)
+                if (isa<BinaryOperator>(I)) ++counts[I.getOpcode() - Instruction::BinaryOpsBegin];
+            // Before the terminator, or before a musttail call that must stay next to its ret
+            Instruction *InsertPt = BB.getTerminatingMustTailCall();
+            if (!InsertPt) InsertPt = BB.getTerminator();
+            IRBuilder<> B(InsertPt);
+            for (unsigned op = 0; op < NumOpcodes; ++op) {
+                if (!counts[op]) continue;
+                seen[op] = true;
+                Value *Slot = B.CreateConstInBoundsGEP2_64(CountersTy, Counters, 0, op);
+                B.CreateStore(B.CreateAdd(B.CreateLoad(I64, Slot), ConstantInt::get(I64, counts[op])), Slot);
+            }
+        }
+    }
+
+    appendToGlobalDtors(M, addDump(M, Counters, seen), 0);
+    return PreservedAnalyses::none();
+}
+
+// Shared by the plugin and lcm-bench
+void registerAnalyses(FunctionAnalysisManager &FAM) {
+    FAM.registerPass([&] { return ExpressionDomainAnalysis(); }); // Shared expression numbering
+    FAM.registerPass([&] { return AvailableExpressions(); });
+    FAM.registerPass([&] { return AnticipatedExpressions(); });
+    FAM.registerPass([&] { return UsedExpressions(); });
+    FAM.registerPass([&] { return PostponableExpressions(); }); // Register Postponable
+    FAM.registerPass([&] { return DominatorTreeAnalysis(); }); // Register Dominator Tree
+}
+
+// What -passes=lcm runs, for lcm-bench
+unsigned runLazyCodeMotion(Function &F, FunctionAnalysisManager &FAM) {
+    unsigned numExpr = FAM.getResult<ExpressionDomainAnalysis>(F).numExpr;
+    if (!ConcurrentAnalysesMinBlocks) {
+        FAM.getResult<AvailableExpressions>(F);
+        FAM.getResult<AnticipatedExpressions>(F);
+    }
+    FAM.getResult<DominatorTreeAnalysis>(F);
+    LazyCodeMotion().run(F, FAM);
+    return numExpr;
+}
 
 } // end namespace UnifiedPass
 
@@ -1454,11 +3842,7 @@ PassPluginLibraryInfo llvmGetPassPluginInfo() {
     [](PassBuilder &PB) {
         // Register the analysis passes so the Pass Manager knows about them
         PB.registerAnalysisRegistrationCallback( [](FunctionAnalysisManager &FAM) {
-             FAM.registerPass([&] { return UnifiedPass::AvailableExpressions(); });
-             FAM.registerPass([&] { return UnifiedPass::AnticipatedExpressions(); });
-             FAM.registerPass([&] { return UnifiedPass::UsedExpressions(); });
-             FAM.registerPass([&] { return UnifiedPass::PostponableExpressions(); }); // Register Postponable
-             FAM.registerPass([&] { return DominatorTreeAnalysis(); }); // Register Dominator Tree
+             UnifiedPass::registerAnalyses(FAM);
         } );
 
         // Register the LCM transformation pass and individual print passes
@@ -1466,37 +3850,66 @@ PassPluginLibraryInfo llvmGetPassPluginInfo() {
             [](StringRef Name, FunctionPassManager &FPM, ArrayRef<PassBuilder::PipelineElement>) -> bool {
                 if (Name == "lcm") {
                     // Add the required analysis passes first, then the transformation
-                    // LCM doesn't strictly need Postponable, so only require the ones it uses.
-                    FPM.addPass(RequireAnalysisPass<UnifiedPass::AvailableExpressions, Function>());
-                    FPM.addPass(RequireAnalysisPass<UnifiedPass::AnticipatedExpressions, Function>());
-                    FPM.addPass(RequireAnalysisPass<UnifiedPass::UsedExpressions, Function>());
+                    // LCM needs neither Used nor Postponable, so only require the ones it uses.
+                    // With -lcm-concurrent-analyses LCM solves them itself, in parallel.
+                    if (!UnifiedPass::ConcurrentAnalysesMinBlocks) {
+                        FPM.addPass(RequireAnalysisPass<UnifiedPass::AvailableExpressions, Function>());
+                        FPM.addPass(RequireAnalysisPass<UnifiedPass::AnticipatedExpressions, Function>());
+                    }
                     FPM.addPass(RequireAnalysisPass<DominatorTreeAnalysis, Function>());
                     // Add the LCM pass itself
                     FPM.addPass(UnifiedPass::LazyCodeMotion());
                     return true; // Name recognized
+                }
+                if (Name == "ssapre") {
+                    // Sparse alternative to lcm: no dataflow matrices, only the dominator tree
+                    FPM.addPass(RequireAnalysisPass<DominatorTreeAnalysis, Function>());
+                    FPM.addPass(UnifiedPass::SSAPRE());
+                    return true;
+                }
+                if (Name == "mcpre") {
+                    // Speculative PRE weighted by block frequencies; finds the frequencies itself
+                    FPM.addPass(RequireAnalysisPass<DominatorTreeAnalysis, Function>());
+                    FPM.addPass(UnifiedPass::MCPRE());
+                    return true;
                 }
                  if (Name == "print-avail") {
-                     FPM.addPass(RequireAnalysisPass<UnifiedPass::AvailableExpressions, Function>());
-                     // The analysis pass itself prints results, no need for extra pass.
+                     // Prints the full tables regardless of -lcm-verbose
+                     FPM.addPass(UnifiedPass::DataflowPrinterPass<UnifiedPass::AvailableExpressions>());
                      return true;
                  }
                   if (Name == "print-anticip") {
-                     FPM.addPass(RequireAnalysisPass<UnifiedPass::AnticipatedExpressions, Function>());
+                     FPM.addPass(UnifiedPass::DataflowPrinterPass<UnifiedPass::AnticipatedExpressions>());
                      return true;
                  }
                   if (Name == "print-used") {
-                     FPM.addPass(RequireAnalysisPass<UnifiedPass::UsedExpressions, Function>());
+                     FPM.addPass(UnifiedPass::DataflowPrinterPass<UnifiedPass::UsedExpressions>());
                      return true;
                  }
                  if (Name == "print-postpon") { // Add print option for Postponable
-                     // Postponable requires Used, so make sure Used runs first
-                     FPM.addPass(RequireAnalysisPass<UnifiedPass::UsedExpressions, Function>());
-                     FPM.addPass(RequireAnalysisPass<UnifiedPass::PostponableExpressions, Function>());
+                     // Postponable pulls in the cached UsedExpressions result itself
+                     FPM.addPass(UnifiedPass::DataflowPrinterPass<UnifiedPass::PostponableExpressions>());
                      return true;
                  }
                 return false; // Name not recognized
             }
         );
+
+        // Module passes: the module-level lcm driver (analyses computed in parallel) and lcm-count
+        PB.registerPipelineParsingCallback(
+            [](StringRef Name, ModulePassManager &MPM, ArrayRef<PassBuilder::PipelineElement>) -> bool {
+                if (Name == "lcm-parallel") {
+                    MPM.addPass(UnifiedPass::LazyCodeMotionModule());
+                    return true;
+                }
+                if (Name == "lcm-count") {
+                    // Instrumentation: executed binary operators per opcode, printed at exit
+                    MPM.addPass(UnifiedPass::LCMCountPass());
+                    return true;
+                }
+                return false;
+            }
+        );
     }
   };
 }
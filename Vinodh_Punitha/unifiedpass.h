@@ -0,0 +1,43 @@
+/**
+ * unifiedpass.h - What unifiedpass.cpp offers to tools linked with it (lcm-bench)
+ *
+ * The passes themselves are reached through the plugin entry point; this is
+ * the small interface for running lcm in process and reading its stage timers.
+ */
+#ifndef UNIFIEDPASS_H
+#define UNIFIEDPASS_H
+
+#include "llvm/IR/Function.h"
+#include "llvm/IR/PassManager.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Timer.h"
+
+namespace UnifiedPass {
+
+// -lcm-time-stages: time every stage of lcm separately
+extern llvm::cl::opt<bool> TimeStages;
+
+enum LCMStage {
+    StageDomain,
+    StageAvailGenKill, StageAvailSolve,
+    StageAnticGenKill, StageAnticSolve,
+    StageUsedGenKill, StageUsedSolve,
+    StagePostponGenKill, StagePostponSolve,
+    StageEarliest, StageLatest, StageInsert,
+    StagePhase1, StagePhase2, StagePhase3,
+    NumLCMStages
+};
+
+// Timer of stage S, or null when stages are not timed (a TimeRegion over null does nothing)
+llvm::Timer *stageTimer(LCMStage S);
+
+// Registers the analyses of the pass (and the dominator tree lcm needs) with FAM
+void registerAnalyses(llvm::FunctionAnalysisManager &FAM);
+
+// Runs the analyses lcm requires and then lcm on F, as -passes=lcm does.
+// Returns the number of expressions in F's domain.
+unsigned runLazyCodeMotion(llvm::Function &F, llvm::FunctionAnalysisManager &FAM);
+
+} // end namespace UnifiedPass
+
+#endif // UNIFIEDPASS_H